@@ -1,35 +1,70 @@
 // #include <Adafruit_TinyUSB.h>
 #include <Adafruit_USBD_XInput.hpp>
 #include <Arduino.h>
+#include <xinput_report.hpp>
 
 Adafruit_USBD_XInput *_xinput;
 
 xinput_report_t _report = {};
+uint16_t _buttons = 0;
 
 bool _led = false;
 uint8_t _led_clk = 0;
+bool _started = false;
 
 void setup() {
     pinMode(PICO_DEFAULT_LED_PIN, OUTPUT);
     digitalWrite(PICO_DEFAULT_LED_PIN, 0);
 
+#if CFG_TUD_CDC
     Serial.end();
+#endif
 
     _xinput = new Adafruit_USBD_XInput();
     _xinput->begin();
+
+#if CFG_TUD_CDC
+    // Interfaces can only be added before the host reads the configuration,
+    // so CDC is added back here, after XInput, and only its use is deferred
     Serial.begin(115200);
+#endif
+}
+
+// Everything the controller does not need to be usable, run once the host
+// has read the first report
+void deferredSetup() {
+#if CFG_TUD_CDC
+    const xinput_startup_t &startup = _xinput->startupTimes();
+    Serial.printf(
+        "attach to first report: %lu us (begin %lu us, mount %lu us)\r\n",
+        (unsigned long)(startup.first_report_us - startup.reset_us),
+        (unsigned long)startup.begun_us,
+        (unsigned long)startup.mounted_us
+    );
+#endif
 }
 
 void loop() {
-    _report.b = !_report.b;
-    _report.a = !_report.a;
-    _report.lb = !_report.lb;
-    _report.rb = !_report.rb;
+    if (!_started && _xinput->startupComplete()) {
+        deferredSetup();
+        _started = true;
+    }
+
+    if (_xinput->suspended()) {
+        // The toggling buttons below would wake the host right away, so just
+        // sleep. A real controller keeps scanning slowly and calls sendReport()
+        // to wake the host on a button press.
+        _xinput->waitResume(100);
+        return;
+    }
+
+    _buttons ^= XINPUT_BUTTON_A | XINPUT_BUTTON_B | XINPUT_BUTTON_LB | XINPUT_BUTTON_RB;
+    xinput_report_set_buttons(&_report, _buttons);
     // _report._reserved[0] = ~_report._reserved[0];
-    while (!_xinput->ready()) {
-        tight_loop_contents();
+    if (_xinput->sendReport(&_report)) {
+        // Sleep until the host has read it rather than spinning on ready()
+        _xinput->waitReportSent();
     }
-    _xinput->sendReport(&_report);
 
     _led_clk++;
     if (_led_clk > 5) {
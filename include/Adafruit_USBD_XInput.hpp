@@ -35,6 +35,30 @@
 #define EPIN 0x81
 #define EPSIZE 32
 
+// Set to 1 to collect transfer statistics, see Adafruit_USBD_XInput::getStats()
+#ifndef CFG_XINPUT_STATS
+#define CFG_XINPUT_STATS 0
+#endif
+
+// Number of XInput interfaces (controllers) a single device can expose. Each
+// one adds its driver state and an MS OS 2.0 function subset in RAM, so
+// multi-seat builds raise this, e.g. to 4.
+#ifndef CFG_XINPUT_MAX_INSTANCES
+#define CFG_XINPUT_MAX_INSTANCES 1
+#endif
+
+// OUT packets per controller that can be queued for readOutPacket(), a power
+// of two. Two more packet buffers are used for receiving.
+#ifndef CFG_XINPUT_OUT_QUEUE
+#define CFG_XINPUT_OUT_QUEUE 4
+#endif
+
+static_assert(
+    CFG_XINPUT_OUT_QUEUE >= 1 && CFG_XINPUT_OUT_QUEUE <= 128 &&
+        (CFG_XINPUT_OUT_QUEUE & (CFG_XINPUT_OUT_QUEUE - 1)) == 0,
+    "CFG_XINPUT_OUT_QUEUE must be a power of two between 1 and 128"
+);
+
 // clang-format off
 
 //--------------------------------------------------------------------+
@@ -90,53 +114,384 @@ typedef struct __attribute((packed, aligned(1))) {
     uint8_t _reserved1[6];
 } xinput_report_t;
 
-bool tud_xinput_ready();
-void receive_xinput_report(void);
-bool send_xinput_report(xinput_report_t *report);
+static_assert(sizeof(xinput_report_t) == 20, "xinput_report_t must match the 20 byte wire format");
+
+// Message types of OUT reports sent by the host
+enum {
+    XINPUT_OUT_RUMBLE = 0x00,
+    XINPUT_OUT_LED = 0x01,
+};
+
+// Histogram buckets are powers of two: bucket 0 counts durations below 128 us,
+// bucket n durations in [64 << n, 128 << n) us, the last one everything above
+#define XINPUT_STATS_BUCKETS 8
+
+typedef struct {
+    uint32_t submitted;     // IN transfers started
+    uint32_t completed;     // IN transfers the host read
+    uint32_t rejected_busy; // sendReport() calls deferred because the IN endpoint was busy
+    uint32_t out_received;  // OUT packets received
+    uint32_t out_overruns;  // OUT packets dropped because the queue was full
+
+    // Vendor control requests answered and stalled. Interface requests are
+    // counted on the addressed instance, device requests on instance 0.
+    uint32_t control_answered;
+    uint32_t control_stalled;
+
+    // Time from IN submission to completion
+    uint32_t latency_hist[XINPUT_STATS_BUCKETS];
+    // Deviation of the IN completion-to-completion interval from the
+    // configured polling interval
+    uint32_t jitter_hist[XINPUT_STATS_BUCKETS];
+} xinput_stats_t;
+
+// Time since boot in microseconds at which each startup milestone was first
+// reached, 0 if not yet
+typedef struct {
+    uint32_t constructed_us;
+    uint32_t begun_us;
+    uint32_t reset_us;        // first bus reset, i.e. the host started enumeration
+    uint32_t mounted_us;      // interface opened by SET_CONFIGURATION
+    uint32_t first_report_us; // host read the first IN report
+} xinput_startup_t;
+
+typedef void (*xinput_latch_cb_t)(void);
+typedef void (*xinput_report_sent_cb_t)(void);
+typedef void (*xinput_rumble_cb_t)(uint8_t left, uint8_t right);
+typedef void (*xinput_led_cb_t)(uint8_t pattern);
+typedef void (*xinput_out_report_cb_t)(const uint8_t *data, uint16_t len);
+typedef void (*xinput_mount_cb_t)(bool mounted);
+
+// Defined in xinput_recorder.hpp
+typedef struct xinput_recorder xinput_recorder_t;
+
+bool tud_xinput_n_ready(uint8_t instance);
+void receive_xinput_n_report(uint8_t instance);
+bool send_xinput_n_report(uint8_t instance, const xinput_report_t *report);
+bool publish_xinput_n_report(uint8_t instance, const xinput_report_t *report);
+bool flush_xinput_n_report(uint8_t instance);
+
+static inline bool tud_xinput_ready() {
+    return tud_xinput_n_ready(0);
+}
+
+static inline void receive_xinput_report(void) {
+    receive_xinput_n_report(0);
+}
+
+static inline bool send_xinput_report(const xinput_report_t *report) {
+    return send_xinput_n_report(0, report);
+}
+
+static inline bool publish_xinput_report(const xinput_report_t *report) {
+    return publish_xinput_n_report(0, report);
+}
+
+static inline bool flush_xinput_report(void) {
+    return flush_xinput_n_report(0);
+}
+
+void xinput_reset(uint8_t rhport);
 uint16_t xinput_open(
     uint8_t rhport,
     const tusb_desc_interface_t *itf_descriptor,
     uint16_t max_length
 );
+bool xinput_control_xfer_callback(
+    uint8_t rhport,
+    uint8_t stage,
+    const tusb_control_request_t *request
+);
 bool xinput_xfer_callback(
     uint8_t rhport,
     uint8_t ep_addr,
     xfer_result_t result,
     uint32_t xferred_bytes
 );
+void xinput_sof(uint8_t rhport, uint32_t frame_count);
+#ifdef ARDUINO_ARCH_ESP32
+uint16_t xinput_load_descriptor(uint8_t *dst, uint8_t *itf);
+#endif
 
 class Adafruit_USBD_XInput : public Adafruit_USBD_Interface {
   public:
+    // interval_ms is the IN polling interval requested from the host, 0 is
+    // not a valid interval and is taken as 1
     Adafruit_USBD_XInput(uint8_t interval_ms = 1);
 
     bool begin(void);
 
     bool ready(void);
-    bool sendReport(xinput_report_t *report);
+
+    // Copies the report into a driver-owned buffer and returns immediately. If
+    // the IN endpoint is busy the report is held and sent on completion of the
+    // current transfer, replacing any older report that is still pending.
+    // While the interface is not open the report is held the same way and
+    // sent as soon as the host opens it.
+    bool sendReport(const xinput_report_t *report);
+
+    // Wait-free variant of sendReport() for a producer running on another core
+    // than the USB stack, e.g. core1 on RP2040. It only hands the report over
+    // to the triple buffer; the USB core submits it on the next IN completion
+    // or SOF, so within a frame, or earlier if it calls flush(). Only one core
+    // may publish to a given instance.
+    bool publishReport(const xinput_report_t *report);
+
+    // Submits the newest published report if the IN endpoint is idle. Call from
+    // the core running the USB stack.
+    bool flush(void);
+
+    // Called from the USB task each time the host has read an IN report
+    void onReportSent(xinput_report_sent_cb_t callback) { _report_sent_cb = callback; }
+
+    // Sleeps until the host has read an IN report, or timeout_ms elapses.
+    // Returns immediately if a report was read since the previous call. Uses
+    // WFE on RP2040 and a task notification on ESP32.
+    bool waitReportSent(uint32_t timeout_ms = 10);
+
+    // SOF-synchronized mode. The callback is invoked once per polling
+    // interval, in the frame the host polls the IN endpoint in, so it can
+    // sample inputs and call sendReport() just before that poll. On RP2040 it
+    // runs from a timer alarm set framePhase() - lead_us after SOF, elsewhere
+    // from the SOF handler. Pass NULL to disable.
+    void setLatchCallback(xinput_latch_cb_t callback, uint16_t lead_us = 100);
+
+    // Smoothed time in microseconds from the USB task handling SOF to it
+    // handling the IN completion. TinyUSB defers both events to the task and
+    // does not timestamp them, so this only approximates the host's polling
+    // phase when the task runs promptly for each event, e.g. tud_task() in a
+    // tight loop. Where the task runs from a periodic tick, as with the 1 ms
+    // interrupt of the Adafruit RP2040 core, both events are usually handled
+    // in the same run and it mostly measures task scheduling. Which frame of
+    // the interval the host polls in is tracked independently of it.
+    uint16_t framePhase(void) { return _frame_phase_us; }
+
+    // When enabled, sendReport() drops reports identical to the last one
+    // queued, but still resends it once keepalive_ms has elapsed since the
+    // last queued report (0 to never resend). The driver has no timer of its
+    // own: the keepalive only goes out if the application keeps calling
+    // sendReport() or publishReport() with the unchanged report.
+    void setChangeDetection(bool enabled, uint16_t keepalive_ms = 0);
+
+    // Reports handed to the driver, i.e. not suppressed. A queued report can
+    // still be superseded by a newer one before the host reads it.
+    uint32_t reportsQueued(void) { return _reports_queued; }
+
+    uint32_t reportsSuppressed(void) { return _reports_suppressed; }
+
+    // True while the host has suspended the bus. sendReport() then returns
+    // false without queuing anything, but a report that differs from the last
+    // one sent signals remote wakeup if the host has enabled it.
+    bool suspended(void);
+
+    // Sleeps until the bus resumes or timeout_ms elapses, returns true if the
+    // bus is no longer suspended. Uses WFE on RP2040.
+    bool waitResume(uint32_t timeout_ms);
+
+    // idle() turns true once no report with new content has been queued for
+    // timeout_ms, so the application can slow its scan loop down. 0 disables.
+    void setIdleTimeout(uint32_t timeout_ms) { _idle_timeout_ms = timeout_ms; }
+
+    bool idle(void);
+
+    // Callbacks for OUT reports, invoked from the USB task once the OUT
+    // endpoint has been re-armed into another buffer. onOutReport() gets a
+    // view of the raw packet which is only valid until the callback returns.
+    void onRumble(xinput_rumble_cb_t callback) { _rumble_cb = callback; }
+
+    void onLed(xinput_led_cb_t callback) { _led_cb = callback; }
+
+    void onOutReport(xinput_out_report_cb_t callback) { _out_report_cb = callback; }
+
+    // Latest rumble levels sent by the host, returns true if they changed
+    // since the previous call
+    bool getRumble(uint8_t *left, uint8_t *right);
+
+    // Latest LED ring pattern sent by the host
+    uint8_t ledPattern(void) { return _led_pattern; }
+
+    // OUT packets can also be queued in arrival order for polling from the
+    // main loop. Queuing is off until enabled, so applications that only use
+    // the callbacks or getRumble() never fill the queue. readOutPacket()
+    // copies the oldest packet into buf and returns its length, or 0 if the
+    // queue is empty. A packet longer than bufsize is truncated.
+    void setOutQueue(bool enabled) { _out_queue_enabled = enabled; }
+
+    uint8_t outPacketsAvailable(void);
+
+    uint16_t readOutPacket(uint8_t *buf, uint16_t bufsize);
+
+    // Packets received while queuing was enabled and the queue was full. They
+    // were still decoded for getRumble() and the callbacks, but not queued.
+    uint32_t outPacketsDropped(void) { return _out_dropped; }
+
+#if CFG_XINPUT_STATS
+    // Copies the counters, safe to call while the stack is running. Individual
+    // counters are consistent, the set as a whole may be one event apart.
+    void getStats(xinput_stats_t *stats);
+
+    void resetStats(void);
+#endif
+
+    // Records the reports the host read, OUT packets and bus events into
+    // recorder, see xinput_recorder.hpp. Reports superseded before they were
+    // sent are not recorded. Only the USB task writes to the recorder: suspend
+    // and resume are noticed by sendReport() or publishReport(), whichever the
+    // application uses, and recorded with that time once the USB task runs
+    // again. Pass NULL to stop recording.
+    void setRecorder(xinput_recorder_t *recorder) { _recorder = recorder; }
+
+    // Plays a recorded log back: reports go through sendReport() and OUT
+    // packets through the same decoding as received ones, so callbacks fire.
+    // With realtime the recorded timing is reproduced, otherwise records are
+    // pushed through as fast as possible. Returns the number of records played.
+    uint32_t replay(const uint8_t *log, uint32_t length, bool realtime);
+
+    // Called from the USB task when the host opens the interface and when a
+    // bus reset or disconnect closes it again. On open the newest report is
+    // resent right away so the host has the current state without waiting for
+    // the application.
+    void onMount(xinput_mount_cb_t callback) { _mount_cb = callback; }
+
+    // Startup milestones. first_report_us - reset_us is the time from attach
+    // to the first report the host accepted.
+    const xinput_startup_t &startupTimes(void) { return _startup; }
+
+    // True once the host has read the first report. Initialization that is
+    // not needed for the controller to be usable is best deferred until then
+    // so it does not compete with enumeration.
+    bool startupComplete(void) {
+        return __atomic_load_n(&_startup.first_report_us, __ATOMIC_ACQUIRE) != 0;
+    }
+
+    // Index of this controller among the XInput interfaces, assigned in begin()
+    uint8_t instance(void) { return _instance; }
 
     // from Adafruit_USBD_Interface
     virtual uint16_t getInterfaceDescriptor(uint8_t itfnum, uint8_t *buf, uint16_t bufsize);
 
   private:
+    void handleOutReport(const uint8_t *data, uint16_t len);
+    uint8_t outQueueTail(void);
+    void trackSuspend(bool suspended);
+    void recordBusEvents(void);
+
     uint8_t _interval_ms;
+    uint8_t _instance = 0xFF;
+    uint8_t _itfnum = 0xFF;
     uint8_t _endpoint_in = 0;
     uint8_t _endpoint_out = 0;
-    uint8_t _xinput_out_buffer[EPSIZE] = {};
 
-    friend bool tud_xinput_ready();
-    friend void receive_xinput_report(void);
-    friend bool send_xinput_report(xinput_report_t *report);
+    // OUT packet buffers, referred to by index. The endpoint receives into
+    // _out_rx. A completed packet is queued by swapping its buffer with the
+    // free one in ring slot _out_head and advancing _out_head, readOutPacket()
+    // consumes from _out_tail; both are free-running counters. A packet that
+    // is not queued is swapped with _out_spare instead. Either way there is a
+    // free buffer to re-arm the endpoint with before the packet is decoded.
+    // A bus reset flushes the queue by publishing the head it reached in
+    // _out_flush_head and bumping _out_flush_gen; the reader applies it.
+    uint8_t _out_buffers[CFG_XINPUT_OUT_QUEUE + 2][EPSIZE] = {};
+    uint8_t _out_length[CFG_XINPUT_OUT_QUEUE + 2] = {};
+    uint8_t _out_ring[CFG_XINPUT_OUT_QUEUE] = {};
+    uint8_t _out_rx = CFG_XINPUT_OUT_QUEUE;
+    uint8_t _out_spare = CFG_XINPUT_OUT_QUEUE + 1;
+    uint8_t _out_head = 0;
+    uint8_t _out_tail = 0;
+    uint8_t _out_flush_head = 0;
+    uint8_t _out_flush_gen = 0;
+    uint8_t _out_flush_seen = 0;
+    bool _out_queue_enabled = false;
+    uint32_t _out_dropped = 0;
+    xinput_rumble_cb_t _rumble_cb = NULL;
+    xinput_led_cb_t _led_cb = NULL;
+    xinput_out_report_cb_t _out_report_cb = NULL;
+    uint16_t _rumble = 0;
+    bool _rumble_updated = false;
+    uint8_t _led_pattern = 0;
+
+    // Triple buffer for IN reports. The back slot is only written by
+    // sendReport(), the front slot is only read by the IN endpoint, and the
+    // middle slot is swapped between them atomically. The middle index carries
+    // XINPUT_REPORT_PENDING when it holds a report that has not been sent yet.
+    xinput_report_t _reports[3] = {};
+    uint8_t _report_back = 0;
+    uint8_t _report_middle = 1;
+    uint8_t _report_front = 2;
+    bool _report_front_sent = false; // the front slot holds a report once submitted
+
+    // Last report queued by sendReport(), for change detection
+    xinput_report_t _report_last = {};
+    bool _change_detection = false;
+    uint16_t _keepalive_ms = 0;
+    uint32_t _last_queued_ms = 0;
+    uint32_t _reports_queued = 0;
+    uint32_t _reports_suppressed = 0;
+
+    // Suspend and idle handling
+    uint32_t _idle_timeout_ms = 0;
+    uint32_t _last_change_ms = 0;
+    bool _wakeup_requested = false;
+    bool _bus_suspended = false; // as last seen by sendReport() or publishReport()
+
+    // Times of the last suspend and resume transitions not recorded yet, 0 if
+    // none. Set by the producer, taken by the USB task.
+    uint32_t _suspend_us = 0;
+    uint32_t _resume_us = 0;
+
+#if CFG_XINPUT_STATS
+    xinput_stats_t _stats = {};
+    uint32_t _in_submit_us = 0;
+    uint32_t _in_complete_us = 0;
+#endif
+
+    // IN completion event
+    xinput_report_sent_cb_t _report_sent_cb = NULL;
+    bool _report_sent = false;
+#ifdef ARDUINO_ARCH_ESP32
+    void *_waiting_task = NULL;
+#endif
+
+    // SOF tracking for the latch callback
+    xinput_latch_cb_t _latch_cb = NULL;
+    uint16_t _latch_lead_us = 0;
+    uint16_t _frame_phase_us = 0;
+    uint8_t _poll_slot = 0;
+    uint32_t _sof_count = 0;
+    uint32_t _sof_time_us = 0;
+
+    xinput_recorder_t *_recorder = NULL;
+    xinput_mount_cb_t _mount_cb = NULL;
+
+    xinput_startup_t _startup = {};
+
+    friend bool tud_xinput_n_ready(uint8_t instance);
+    friend void receive_xinput_n_report(uint8_t instance);
+    friend bool send_xinput_n_report(uint8_t instance, const xinput_report_t *report);
+    friend bool publish_xinput_n_report(uint8_t instance, const xinput_report_t *report);
+    friend bool flush_xinput_n_report(uint8_t instance);
+    friend void xinput_reset(uint8_t rhport);
     friend uint16_t xinput_open(
         uint8_t rhport,
         const tusb_desc_interface_t *itf_descriptor,
         uint16_t max_length
     );
+    friend bool xinput_control_xfer_callback(
+        uint8_t rhport,
+        uint8_t stage,
+        const tusb_control_request_t *request
+    );
     friend bool xinput_xfer_callback(
         uint8_t rhport,
         uint8_t ep_addr,
         xfer_result_t result,
         uint32_t xferred_bytes
     );
+    friend void xinput_sof(uint8_t rhport, uint32_t frame_count);
+    friend bool xinput_register(Adafruit_USBD_XInput *dev);
+    friend void xinput_update_ms_os_20(void);
+#ifdef ARDUINO_ARCH_ESP32
+    friend uint16_t xinput_load_descriptor(uint8_t *dst, uint8_t *itf);
+#endif
     friend const usbd_class_driver_t *usbd_app_driver_get_cb(uint8_t *driver_count);
     friend bool tud_vendor_control_xfer_cb(
         uint8_t rhport,
@@ -37,8 +37,14 @@ extern "C" {
 // Enable device stack
 #define CFG_TUD_ENABLED 1
 
+// Lean profile for XInput-only devices: compiles out every other device class
+// and the host stack, and sizes the remaining buffers to the XInput EPSIZE
+#ifndef CFG_XINPUT_LEAN
+#define CFG_XINPUT_LEAN 0
+#endif
+
 // Enable host stack with pio-usb if Pico-PIO-USB library is available
-#if __has_include("pio_usb.h")
+#if __has_include("pio_usb.h") && !CFG_XINPUT_LEAN
 #define CFG_TUH_ENABLED 1
 #define CFG_TUH_RPI_PIO_USB 1
 #endif
@@ -66,6 +72,30 @@ extern int serial1_printf(const char *__restrict __format, ...);
 
 #define CFG_TUD_ENDOINT0_SIZE 64
 
+#if CFG_XINPUT_LEAN
+
+#define CFG_TUD_CDC 0
+#define CFG_TUD_MSC 0
+#define CFG_TUD_HID 0
+#define CFG_TUD_MIDI 0
+#define CFG_TUD_VENDOR 0
+
+// One controller and a minimal OUT queue
+#define CFG_XINPUT_MAX_INSTANCES 1
+#define CFG_XINPUT_OUT_QUEUE 1
+
+// Unused, kept at the XInput endpoint size in case a class is re-enabled
+#define CFG_TUD_CDC_RX_BUFSIZE 32
+#define CFG_TUD_CDC_TX_BUFSIZE 32
+#define CFG_TUD_MSC_EP_BUFSIZE 32
+#define CFG_TUD_HID_EP_BUFSIZE 32
+#define CFG_TUD_MIDI_RX_BUFSIZE 32
+#define CFG_TUD_MIDI_TX_BUFSIZE 32
+#define CFG_TUD_VENDOR_RX_BUFSIZE 32
+#define CFG_TUD_VENDOR_TX_BUFSIZE 32
+
+#else
+
 #define CFG_TUD_CDC 1
 #define CFG_TUD_MSC 1
 #define CFG_TUD_HID 1
@@ -90,6 +120,8 @@ extern int serial1_printf(const char *__restrict __format, ...);
 #define CFG_TUD_VENDOR_RX_BUFSIZE 64
 #define CFG_TUD_VENDOR_TX_BUFSIZE 64
 
+#endif
+
 //--------------------------------------------------------------------
 // Host Configuration
 //--------------------------------------------------------------------
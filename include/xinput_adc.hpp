@@ -0,0 +1,109 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef XINPUT_ADC_HPP_
+#define XINPUT_ADC_HPP_
+
+#include <stdint.h>
+
+// Analog acquisition for sticks and triggers. On RP2040 the ADC free-runs in
+// round-robin mode and DMA streams the samples into a ring, so the CPU never
+// waits for a conversion. xinput_adc_poll() runs the new samples through a
+// fixed-point low-pass filter, after which the latest values can be read at
+// any time and fed to xinput_stick_process() / xinput_trigger_process().
+//
+// The filter is independent of the hardware and works on any interleaved
+// sample stream.
+
+#define XINPUT_ADC_MAX_CHANNELS 4
+
+//--------------------------------------------------------------------+
+// Filter
+//--------------------------------------------------------------------+
+
+// Per-channel exponential moving average: every sample moves the output
+// 1 / 2^shift of the way towards it. Samples are 12-bit, outputs are scaled to
+// 16 bits to keep the fractional resolution gained by averaging.
+typedef struct {
+    uint8_t channels;
+    uint8_t shift;
+    uint8_t primed; // bit n set once channel n has seen a sample
+    uint32_t acc[XINPUT_ADC_MAX_CHANNELS]; // output << shift
+} xinput_adc_filter_t;
+
+// Returns false unless 1 <= channels <= XINPUT_ADC_MAX_CHANNELS; the filter
+// then ignores all samples
+bool xinput_adc_filter_init(xinput_adc_filter_t *filter, uint8_t channels, uint8_t shift);
+
+// Feeds count interleaved samples, the first one belonging to channel first.
+// Nothing is done if first is not below the channel count.
+void xinput_adc_filter_process(
+    xinput_adc_filter_t *filter,
+    const uint16_t *samples,
+    uint32_t count,
+    uint8_t first
+);
+
+static inline uint16_t xinput_adc_filter_value(const xinput_adc_filter_t *filter, uint8_t channel) {
+    return (uint16_t)(filter->acc[channel] >> filter->shift);
+}
+
+//--------------------------------------------------------------------+
+// RP2040 DMA acquisition
+//--------------------------------------------------------------------+
+
+#ifdef ARDUINO_ARCH_RP2040
+
+// Multiple of every possible channel count so a position in the ring always
+// maps to the same channel
+#define XINPUT_ADC_RING_SIZE 96
+
+typedef struct {
+    xinput_adc_filter_t filter;
+    uint16_t ring[XINPUT_ADC_RING_SIZE];
+    uint16_t *ring_start; // read by the control DMA channel, NULL while stopped
+    uint32_t read_pos;
+    int data_channel;    // -1 if not claimed
+    int control_channel; // -1 if not claimed
+} xinput_adc_t;
+
+// Starts sampling the ADC inputs in channel_mask (bit n is ADC input n, GPIO
+// 26 + n) at sample_rate conversions per second in total. Filtered values are
+// indexed by position among the selected inputs, lowest input first.
+bool xinput_adc_start(xinput_adc_t *adc, uint8_t channel_mask, uint32_t sample_rate, uint8_t shift);
+
+// Safe to call on a zero-initialized or already stopped acquisition
+void xinput_adc_stop(xinput_adc_t *adc);
+
+// Filters the samples written since the previous call. Call it at least once
+// per XINPUT_ADC_RING_SIZE samples; older ones are overwritten by then.
+void xinput_adc_poll(xinput_adc_t *adc);
+
+static inline uint16_t xinput_adc_value(const xinput_adc_t *adc, uint8_t index) {
+    return xinput_adc_filter_value(&adc->filter, index);
+}
+
+#endif
+
+#endif /* XINPUT_ADC_HPP_ */
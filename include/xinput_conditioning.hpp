@@ -0,0 +1,136 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef XINPUT_CONDITIONING_HPP_
+#define XINPUT_CONDITIONING_HPP_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Fixed-point conditioning of raw ADC counts into XInput stick and trigger
+// values: calibration, radial or axial deadzone, anti-deadzone and a response
+// curve. Magnitudes are Q15, i.e. 32767 is full deflection. All divisions by
+// configuration values are done once in the *_init() functions; processing a
+// stick costs one 16-step integer square root (radial mode) and one division.
+
+//--------------------------------------------------------------------+
+// Response curves
+//--------------------------------------------------------------------+
+
+#define XINPUT_CURVE_SEGMENTS 64
+#define XINPUT_CURVE_SHIFT 9 // 32768 / XINPUT_CURVE_SEGMENTS = 1 << 9
+
+// Piecewise linear mapping of a Q15 magnitude onto a Q15 magnitude
+typedef struct {
+    int16_t points[XINPUT_CURVE_SEGMENTS + 1];
+} xinput_curve_t;
+
+// "Expo" curve blending linear and cubic response: expo 0 is linear, 255 is
+// fully cubic, giving finer control around center. Declare the result
+// constexpr so the table is generated at compile time and kept in flash.
+constexpr xinput_curve_t xinput_curve_expo(uint8_t expo) {
+    xinput_curve_t curve = {};
+    for (int32_t i = 0; i <= XINPUT_CURVE_SEGMENTS; i++) {
+        const int64_t x = i == XINPUT_CURVE_SEGMENTS ? 32767 : i << XINPUT_CURVE_SHIFT;
+        // Normalized to 32767 rather than 32768 so full deflection stays full
+        const int64_t cubic = (x * x * x) / (32767 * 32767);
+        curve.points[i] = (int16_t)(x + ((cubic - x) * expo) / 255);
+    }
+    return curve;
+}
+
+//--------------------------------------------------------------------+
+// Configuration
+//--------------------------------------------------------------------+
+
+// Raw ADC counts at the ends and rest position of an axis
+typedef struct {
+    uint16_t min;
+    uint16_t center;
+    uint16_t max;
+    bool invert;
+} xinput_axis_cal_t;
+
+typedef struct {
+    xinput_axis_cal_t x;
+    xinput_axis_cal_t y;
+    uint16_t deadzone;           // Q15, magnitudes at or below it report 0
+    uint16_t anti_deadzone;      // Q15, smallest magnitude reported outside the deadzone
+    bool radial;                 // deadzone on stick magnitude instead of per axis
+    const xinput_curve_t *curve; // NULL for linear
+} xinput_stick_config_t;
+
+typedef struct {
+    uint16_t min; // raw count when released
+    uint16_t max; // raw count when fully pressed, may be below min
+    uint16_t deadzone;
+    uint16_t anti_deadzone;
+    const xinput_curve_t *curve;
+} xinput_trigger_config_t;
+
+//--------------------------------------------------------------------+
+// Precomputed state
+//--------------------------------------------------------------------+
+
+typedef struct {
+    int32_t center;
+    int32_t neg_span;
+    int32_t pos_span;
+    int32_t neg_scale; // Q16 factor mapping neg_span to 32767
+    int32_t pos_scale;
+    bool invert;
+} xinput_axis_t;
+
+typedef struct {
+    int32_t deadzone;
+    int32_t anti_deadzone;
+    int32_t rescale; // Q15 factor mapping (deadzone, 32767] onto (anti_deadzone, 32767]
+    const xinput_curve_t *curve;
+} xinput_response_t;
+
+typedef struct {
+    xinput_axis_t x;
+    xinput_axis_t y;
+    xinput_response_t response;
+    bool radial;
+} xinput_stick_t;
+
+typedef struct {
+    xinput_axis_t axis;
+    xinput_response_t response;
+} xinput_trigger_t;
+
+void xinput_stick_init(xinput_stick_t *stick, const xinput_stick_config_t *config);
+void xinput_stick_process(
+    const xinput_stick_t *stick,
+    uint16_t raw_x,
+    uint16_t raw_y,
+    int16_t *x,
+    int16_t *y
+);
+
+void xinput_trigger_init(xinput_trigger_t *trigger, const xinput_trigger_config_t *config);
+uint8_t xinput_trigger_process(const xinput_trigger_t *trigger, uint16_t raw);
+
+#endif /* XINPUT_CONDITIONING_HPP_ */
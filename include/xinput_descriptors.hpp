@@ -0,0 +1,214 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef XINPUT_DESCRIPTORS_HPP_
+#define XINPUT_DESCRIPTORS_HPP_
+
+#include "Adafruit_USBD_XInput.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Compile-time builders for the XInput interface, BOS and MS OS 2.0
+// descriptors. All lengths are derived from the content so they can be
+// static_assert'ed instead of counted by hand, and results declared constexpr
+// end up in flash.
+
+template <size_t N> struct xinput_desc_t {
+    uint8_t data[N];
+
+    static constexpr size_t length = N;
+};
+
+// Property name and value bound to the XUSB driver, both in UTF-16 on the wire
+#define XINPUT_MS_OS_20_PROPERTY_NAME "DeviceInterfaceGUIDs"
+#define XINPUT_MS_OS_20_PROPERTY_DATA "{8D90842C-1594-41CE-AA3F-62D464E1BE79}"
+
+// PropertyName is a NUL-terminated string, PropertyData a REG_MULTI_SZ with
+// an extra terminating NUL
+#define XINPUT_MS_OS_20_PROPERTY_NAME_LEN (sizeof(XINPUT_MS_OS_20_PROPERTY_NAME) * 2)
+#define XINPUT_MS_OS_20_PROPERTY_DATA_LEN ((sizeof(XINPUT_MS_OS_20_PROPERTY_DATA) + 1) * 2)
+
+#define XINPUT_MS_OS_20_SET_HEADER_LEN 0x0A
+#define XINPUT_MS_OS_20_CONFIG_HEADER_LEN 0x08
+#define XINPUT_MS_OS_20_FUNCTION_HEADER_LEN 0x08
+#define XINPUT_MS_OS_20_COMPATIBLE_ID_LEN 0x14
+#define XINPUT_MS_OS_20_REG_PROPERTY_LEN \
+    (10 + XINPUT_MS_OS_20_PROPERTY_NAME_LEN + XINPUT_MS_OS_20_PROPERTY_DATA_LEN)
+
+#define XINPUT_MS_OS_20_HEADER_LEN \
+    (XINPUT_MS_OS_20_SET_HEADER_LEN + XINPUT_MS_OS_20_CONFIG_HEADER_LEN)
+#define XINPUT_MS_OS_20_FUNCTION_LEN \
+    (XINPUT_MS_OS_20_FUNCTION_HEADER_LEN + XINPUT_MS_OS_20_COMPATIBLE_ID_LEN + \
+     XINPUT_MS_OS_20_REG_PROPERTY_LEN)
+#define XINPUT_MS_OS_20_DESC_LEN(_count) \
+    (XINPUT_MS_OS_20_HEADER_LEN + (_count) * XINPUT_MS_OS_20_FUNCTION_LEN)
+
+#define XINPUT_BOS_DESC_LEN (TUD_BOS_DESC_LEN + TUD_BOS_MICROSOFT_OS_DESC_LEN)
+
+// Offsets of the fields patched at runtime in TUD_XINPUT_DESCRIPTOR
+#define XINPUT_ITF_DESC_ITFNUM_OFFSET 2
+#define XINPUT_ITF_DESC_EPIN_OFFSET (9 + 16 + 2)
+#define XINPUT_ITF_DESC_INTERVAL_OFFSET (9 + 16 + 6)
+#define XINPUT_ITF_DESC_EPOUT_OFFSET (9 + 16 + 7 + 2)
+
+// Offset of bFirstInterface in a function subset and of
+// wMSOSDescriptorSetTotalLength in the BOS descriptor
+#define XINPUT_MS_OS_20_FUNCTION_ITFNUM_OFFSET 4
+#define XINPUT_BOS_MS_OS_20_LEN_OFFSET (XINPUT_BOS_DESC_LEN - 4)
+
+//--------------------------------------------------------------------+
+// Builders
+//--------------------------------------------------------------------+
+
+template <size_t N>
+constexpr size_t xinput_desc_u8(xinput_desc_t<N> &desc, size_t pos, uint8_t value) {
+    desc.data[pos] = value;
+    return pos + 1;
+}
+
+template <size_t N>
+constexpr size_t xinput_desc_u16(xinput_desc_t<N> &desc, size_t pos, uint16_t value) {
+    pos = xinput_desc_u8(desc, pos, TU_U16_LOW(value));
+    return xinput_desc_u8(desc, pos, TU_U16_HIGH(value));
+}
+
+template <size_t N>
+constexpr size_t xinput_desc_u32(xinput_desc_t<N> &desc, size_t pos, uint32_t value) {
+    pos = xinput_desc_u16(desc, pos, (uint16_t)(value & 0xFFFF));
+    return xinput_desc_u16(desc, pos, (uint16_t)(value >> 16));
+}
+
+// ASCII string widened to UTF-16LE, including the terminating NUL
+template <size_t N>
+constexpr size_t xinput_desc_utf16(xinput_desc_t<N> &desc, size_t pos, const char *str) {
+    do {
+        pos = xinput_desc_u16(desc, pos, (uint8_t)*str);
+    } while (*str++);
+    return pos;
+}
+
+constexpr xinput_desc_t<TUD_XINPUT_DESC_LEN> xinput_interface_desc(
+    uint8_t itfnum,
+    uint8_t ep_out,
+    uint8_t ep_in,
+    uint8_t interval_ms
+) {
+    return { { TUD_XINPUT_DESCRIPTOR(itfnum, 0, ep_out, ep_in, EPSIZE, interval_ms) } };
+}
+
+constexpr xinput_desc_t<XINPUT_BOS_DESC_LEN> xinput_bos_desc(
+    uint16_t ms_os_20_len,
+    uint8_t vendor_code
+) {
+    return { { TUD_BOS_DESCRIPTOR(XINPUT_BOS_DESC_LEN, 1),
+               TUD_BOS_MS_OS_20_DESCRIPTOR(ms_os_20_len, vendor_code) } };
+}
+
+// Set header and configuration subset header for a set of total_len bytes
+constexpr xinput_desc_t<XINPUT_MS_OS_20_HEADER_LEN> xinput_ms_os_20_header(uint16_t total_len) {
+    xinput_desc_t<XINPUT_MS_OS_20_HEADER_LEN> desc = {};
+    size_t pos = 0;
+
+    // Set header: length, type, windows version, total length
+    pos = xinput_desc_u16(desc, pos, XINPUT_MS_OS_20_SET_HEADER_LEN);
+    pos = xinput_desc_u16(desc, pos, MS_OS_20_SET_HEADER_DESCRIPTOR);
+    pos = xinput_desc_u32(desc, pos, 0x06030000);
+    pos = xinput_desc_u16(desc, pos, total_len);
+
+    // Configuration subset header: length, type, configuration index, reserved,
+    // configuration total length
+    pos = xinput_desc_u16(desc, pos, XINPUT_MS_OS_20_CONFIG_HEADER_LEN);
+    pos = xinput_desc_u16(desc, pos, MS_OS_20_SUBSET_HEADER_CONFIGURATION);
+    pos = xinput_desc_u8(desc, pos, 0);
+    pos = xinput_desc_u8(desc, pos, 0);
+    pos = xinput_desc_u16(desc, pos, total_len - XINPUT_MS_OS_20_SET_HEADER_LEN);
+
+    return desc;
+}
+
+// Function subset binding interface itfnum to the XUSB driver
+constexpr xinput_desc_t<XINPUT_MS_OS_20_FUNCTION_LEN> xinput_ms_os_20_function(uint8_t itfnum) {
+    xinput_desc_t<XINPUT_MS_OS_20_FUNCTION_LEN> desc = {};
+    size_t pos = 0;
+
+    // Function Subset header: length, type, first interface, reserved, subset
+    // length
+    pos = xinput_desc_u16(desc, pos, XINPUT_MS_OS_20_FUNCTION_HEADER_LEN);
+    pos = xinput_desc_u16(desc, pos, MS_OS_20_SUBSET_HEADER_FUNCTION);
+    pos = xinput_desc_u8(desc, pos, itfnum);
+    pos = xinput_desc_u8(desc, pos, 0);
+    pos = xinput_desc_u16(desc, pos, XINPUT_MS_OS_20_FUNCTION_LEN);
+
+    // MS OS 2.0 Compatible ID descriptor: length, type, compatible ID, sub
+    // compatible ID
+    pos = xinput_desc_u16(desc, pos, XINPUT_MS_OS_20_COMPATIBLE_ID_LEN);
+    pos = xinput_desc_u16(desc, pos, MS_OS_20_FEATURE_COMPATBLE_ID);
+    const char compatible_id[] = "XUSB20";
+    for (size_t i = 0; i < 16; i++) {
+        pos = xinput_desc_u8(desc, pos, i < sizeof(compatible_id) ? compatible_id[i] : 0);
+    }
+
+    // MS OS 2.0 Registry property descriptor: length, type, wPropertyDataType
+    // (REG_MULTI_SZ), wPropertyNameLength, PropertyName, wPropertyDataLength,
+    // PropertyData
+    pos = xinput_desc_u16(desc, pos, XINPUT_MS_OS_20_REG_PROPERTY_LEN);
+    pos = xinput_desc_u16(desc, pos, MS_OS_20_FEATURE_REG_PROPERTY);
+    pos = xinput_desc_u16(desc, pos, 0x0007);
+    pos = xinput_desc_u16(desc, pos, XINPUT_MS_OS_20_PROPERTY_NAME_LEN);
+    pos = xinput_desc_utf16(desc, pos, XINPUT_MS_OS_20_PROPERTY_NAME);
+    pos = xinput_desc_u16(desc, pos, XINPUT_MS_OS_20_PROPERTY_DATA_LEN);
+    pos = xinput_desc_utf16(desc, pos, XINPUT_MS_OS_20_PROPERTY_DATA);
+    pos = xinput_desc_u16(desc, pos, 0);
+
+    return desc;
+}
+
+// Complete MS OS 2.0 set for count XInput interfaces numbered consecutively
+// from first_itf
+template <uint8_t first_itf, uint8_t count>
+constexpr xinput_desc_t<XINPUT_MS_OS_20_DESC_LEN(count)> xinput_ms_os_20_desc() {
+    xinput_desc_t<XINPUT_MS_OS_20_DESC_LEN(count)> desc = {};
+    size_t pos = 0;
+
+    const auto header = xinput_ms_os_20_header(XINPUT_MS_OS_20_DESC_LEN(count));
+    for (size_t i = 0; i < header.length; i++) {
+        pos = xinput_desc_u8(desc, pos, header.data[i]);
+    }
+
+    for (uint8_t itf = first_itf; itf < first_itf + count; itf++) {
+        const auto function = xinput_ms_os_20_function(itf);
+        for (size_t i = 0; i < function.length; i++) {
+            pos = xinput_desc_u8(desc, pos, function.data[i]);
+        }
+    }
+
+    return desc;
+}
+
+// The historical hand-counted length of a single-function set
+static_assert(XINPUT_MS_OS_20_DESC_LEN(1) == 0xB2, "MS OS 2.0 descriptor set length");
+static_assert(XINPUT_MS_OS_20_REG_PROPERTY_LEN == 0x84, "MS OS 2.0 registry property length");
+
+#endif /* XINPUT_DESCRIPTORS_HPP_ */
@@ -0,0 +1,106 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef XINPUT_HID_ADAPTER_HPP_
+#define XINPUT_HID_ADAPTER_HPP_
+
+#include "Adafruit_USBD_XInput.hpp"
+
+#include <stdint.h>
+
+// Translation of reports from a HID gamepad, e.g. one attached to the PIO-USB
+// host port, into XInput reports. The layout of the HID report is described
+// by an xinput_hid_map_t, typically filled in once per supported VID/PID.
+// Forward from the application's TinyUSB host callback so the translated
+// report is handed over as soon as the HID report arrives:
+//
+//   void tuh_hid_report_received_cb(uint8_t dev_addr, uint8_t instance,
+//                                   const uint8_t *report, uint16_t len) {
+//       xinput_hid_forward(xinput, &pad_map, report, len);
+//       tuh_hid_receive_report(dev_addr, instance);
+//   }
+//
+// With PIO-USB the host stack usually runs on core1, so the report is only
+// published. The core running the device stack sends it on the next IN
+// completion or SOF, or sooner if it calls xinput->flush().
+
+// Marks a button or axis without a source in the HID report
+#define XINPUT_HID_NONE 0xFF
+
+// Axis encodings in the HID report
+enum {
+    XINPUT_HID_AXIS_U8 = 0,  // 0..255, centered at 128 for sticks
+    XINPUT_HID_AXIS_S8 = 1,  // -128..127
+    XINPUT_HID_AXIS_U16 = 2, // 0..65535 little-endian, centered at 32768
+    XINPUT_HID_AXIS_S16 = 3, // -32768..32767 little-endian
+    XINPUT_HID_AXIS_TYPE_MASK = 0x03,
+
+    // Flip the direction, HID Y axes usually grow downwards
+    XINPUT_HID_AXIS_INVERT = 0x80,
+};
+
+typedef struct {
+    uint8_t offset; // byte offset after the report ID, XINPUT_HID_NONE if unmapped
+    uint8_t mask;
+} xinput_hid_button_t;
+
+typedef struct {
+    uint8_t offset; // byte offset after the report ID, XINPUT_HID_NONE if unmapped
+    uint8_t flags;  // XINPUT_HID_AXIS_* type, optionally ORed with XINPUT_HID_AXIS_INVERT
+} xinput_hid_axis_t;
+
+typedef struct {
+    uint8_t report_id; // expected first byte of the report, 0 if IDs are not used
+
+    // Indexed by XInput button bit, see XINPUT_BUTTON_*
+    xinput_hid_button_t buttons[16];
+
+    // Hat switch driving the D-pad, 0-7 clockwise from up and anything else
+    // centered. The low nibble of the byte is used.
+    uint8_t hat_offset;
+
+    xinput_hid_axis_t lx, ly, rx, ry;
+    xinput_hid_axis_t lt, rt;
+} xinput_hid_map_t;
+
+// Returns false if the report does not carry the expected report ID or is too
+// short for the map
+bool xinput_hid_translate(
+    const xinput_hid_map_t *map,
+    const uint8_t *hid,
+    uint16_t len,
+    xinput_report_t *report
+);
+
+// Translates the report and publishes it with publishReport(), safe to call
+// from another core than the device stack
+bool xinput_hid_forward(
+    Adafruit_USBD_XInput *xinput,
+    const xinput_hid_map_t *map,
+    const uint8_t *hid,
+    uint16_t len
+);
+
+#endif /* XINPUT_HID_ADAPTER_HPP_ */
@@ -0,0 +1,113 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef XINPUT_RECORDER_HPP_
+#define XINPUT_RECORDER_HPP_
+
+#include "Adafruit_USBD_XInput.hpp"
+
+#include <stdint.h>
+
+// Compact append-only log of the reports the host read, OUT packets received
+// and bus events seen by the driver, recorded into a caller-provided RAM buffer and
+// read back with xinput_log_read() or replayed with
+// Adafruit_USBD_XInput::replay().
+//
+// Every record starts with a tag byte, type in the top 3 bits, followed by the
+// time since the previous record in microseconds as an unsigned LEB128 varint:
+//
+//   REPORT  tag low bits: mask of the 32-bit report words that changed since
+//           the previous report record, followed by those words
+//   OUT     tag low bits unused, then a length byte and the packet
+//   EVENT   tag low bits: event code
+//
+// The first report of a log is encoded against an all-zero report.
+
+enum {
+    XINPUT_LOG_REPORT = 1,
+    XINPUT_LOG_OUT = 2,
+    XINPUT_LOG_EVENT = 3,
+};
+
+enum {
+    XINPUT_LOG_EVENT_MOUNT = 0,
+    XINPUT_LOG_EVENT_RESET = 1,
+    XINPUT_LOG_EVENT_SUSPEND = 2,
+    XINPUT_LOG_EVENT_RESUME = 3,
+};
+
+#define XINPUT_LOG_TYPE_SHIFT 5
+#define XINPUT_LOG_ARG_MASK 0x1F
+#define XINPUT_LOG_REPORT_WORDS (sizeof(xinput_report_t) / sizeof(uint32_t))
+
+// Largest record: tag, 5 byte varint, length byte and a full OUT packet
+#define XINPUT_LOG_RECORD_MAX (1 + 5 + 1 + EPSIZE)
+
+// Declared as xinput_recorder_t in Adafruit_USBD_XInput.hpp
+struct xinput_recorder {
+    uint8_t *buffer;
+    uint32_t capacity;
+    uint32_t length;
+    uint32_t dropped; // records that did not fit
+    uint32_t last_us;
+    xinput_report_t last_report;
+};
+
+typedef struct {
+    uint8_t type;
+    uint32_t time_us; // since the first record
+    const xinput_report_t *report;
+    const uint8_t *data;
+    uint8_t length;
+    uint8_t event;
+} xinput_log_record_t;
+
+typedef struct {
+    const uint8_t *buffer;
+    uint32_t length;
+    uint32_t pos;
+    uint32_t time_us;
+    xinput_report_t report;
+} xinput_log_reader_t;
+
+void xinput_recorder_init(xinput_recorder_t *recorder, uint8_t *buffer, uint32_t capacity);
+bool xinput_recorder_report(
+    xinput_recorder_t *recorder,
+    uint32_t now_us,
+    const xinput_report_t *report
+);
+bool xinput_recorder_out(
+    xinput_recorder_t *recorder,
+    uint32_t now_us,
+    const uint8_t *data,
+    uint8_t length
+);
+bool xinput_recorder_event(xinput_recorder_t *recorder, uint32_t now_us, uint8_t event);
+
+void xinput_log_reader_init(xinput_log_reader_t *reader, const uint8_t *buffer, uint32_t length);
+// Returns false at the end of the log or on a truncated record. The report and
+// data pointers stay valid until the next call.
+bool xinput_log_read(xinput_log_reader_t *reader, xinput_log_record_t *record);
+
+#endif /* XINPUT_RECORDER_HPP_ */
@@ -0,0 +1,157 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef XINPUT_REPORT_HPP_
+#define XINPUT_REPORT_HPP_
+
+#include "Adafruit_USBD_XInput.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Report packing that does not depend on how the compiler lays out the
+// xinput_report_t bitfields. Buttons are handled as one 16-bit word and
+// multi-byte fields are written explicitly in little-endian order.
+
+// Button bits of the 16-bit button word, bit 0 is bit 0 of report byte 2
+enum {
+    XINPUT_BUTTON_DPAD_UP = 1 << 0,
+    XINPUT_BUTTON_DPAD_DOWN = 1 << 1,
+    XINPUT_BUTTON_DPAD_LEFT = 1 << 2,
+    XINPUT_BUTTON_DPAD_RIGHT = 1 << 3,
+    XINPUT_BUTTON_START = 1 << 4,
+    XINPUT_BUTTON_BACK = 1 << 5,
+    XINPUT_BUTTON_LS = 1 << 6,
+    XINPUT_BUTTON_RS = 1 << 7,
+    XINPUT_BUTTON_LB = 1 << 8,
+    XINPUT_BUTTON_RB = 1 << 9,
+    XINPUT_BUTTON_HOME = 1 << 10,
+    XINPUT_BUTTON_A = 1 << 12,
+    XINPUT_BUTTON_B = 1 << 13,
+    XINPUT_BUTTON_X = 1 << 14,
+    XINPUT_BUTTON_Y = 1 << 15,
+};
+
+#define XINPUT_BUTTON_COUNT 16
+
+// Byte offsets within the 20 byte report
+#define XINPUT_REPORT_BUTTONS_OFFSET 2
+#define XINPUT_REPORT_LT_OFFSET 4
+#define XINPUT_REPORT_RT_OFFSET 5
+#define XINPUT_REPORT_LX_OFFSET 6
+#define XINPUT_REPORT_LY_OFFSET 8
+#define XINPUT_REPORT_RX_OFFSET 10
+#define XINPUT_REPORT_RY_OFFSET 12
+
+static_assert(offsetof(xinput_report_t, lt) == XINPUT_REPORT_LT_OFFSET, "report layout");
+static_assert(offsetof(xinput_report_t, rt) == XINPUT_REPORT_RT_OFFSET, "report layout");
+static_assert(offsetof(xinput_report_t, lx) == XINPUT_REPORT_LX_OFFSET, "report layout");
+static_assert(offsetof(xinput_report_t, ry) == XINPUT_REPORT_RY_OFFSET, "report layout");
+
+static inline void xinput_put_le16(uint8_t *dst, uint16_t value) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(dst, &value, sizeof(value));
+#else
+    dst[0] = (uint8_t)value;
+    dst[1] = (uint8_t)(value >> 8);
+#endif
+}
+
+static inline uint16_t xinput_get_le16(const uint8_t *src) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint16_t value;
+    memcpy(&value, src, sizeof(value));
+    return value;
+#else
+    return (uint16_t)(src[0] | (src[1] << 8));
+#endif
+}
+
+static inline void xinput_report_set_buttons(xinput_report_t *report, uint16_t buttons) {
+    xinput_put_le16((uint8_t *)report + XINPUT_REPORT_BUTTONS_OFFSET, buttons);
+}
+
+static inline uint16_t xinput_report_get_buttons(const xinput_report_t *report) {
+    return xinput_get_le16((const uint8_t *)report + XINPUT_REPORT_BUTTONS_OFFSET);
+}
+
+static inline void xinput_report_set_triggers(xinput_report_t *report, uint8_t lt, uint8_t rt) {
+    ((uint8_t *)report)[XINPUT_REPORT_LT_OFFSET] = lt;
+    ((uint8_t *)report)[XINPUT_REPORT_RT_OFFSET] = rt;
+}
+
+static inline void xinput_report_set_sticks(
+    xinput_report_t *report,
+    int16_t lx,
+    int16_t ly,
+    int16_t rx,
+    int16_t ry
+) {
+    uint8_t *dst = (uint8_t *)report;
+    xinput_put_le16(dst + XINPUT_REPORT_LX_OFFSET, (uint16_t)lx);
+    xinput_put_le16(dst + XINPUT_REPORT_LY_OFFSET, (uint16_t)ly);
+    xinput_put_le16(dst + XINPUT_REPORT_RX_OFFSET, (uint16_t)rx);
+    xinput_put_le16(dst + XINPUT_REPORT_RY_OFFSET, (uint16_t)ry);
+}
+
+//--------------------------------------------------------------------+
+// Pin remapping
+//--------------------------------------------------------------------+
+
+// Marks an XInput button that is not wired to any input
+#define XINPUT_PIN_NONE 0xFF
+
+// Translates a 32-bit GPIO bank value to the XInput button word with four
+// byte-indexed lookups. Generate it at compile time with xinput_button_remap().
+typedef struct {
+    uint16_t lut[4][256];
+} xinput_button_remap_t;
+
+// pins[n] is the GPIO bit (0-31) that drives XInput button bit n, or
+// XINPUT_PIN_NONE. Declare the result constexpr to keep the 2 KiB table in
+// flash.
+constexpr xinput_button_remap_t xinput_button_remap(const uint8_t (&pins)[XINPUT_BUTTON_COUNT]) {
+    xinput_button_remap_t map = {};
+    for (uint8_t bank_byte = 0; bank_byte < 4; bank_byte++) {
+        for (uint16_t value = 0; value < 256; value++) {
+            uint16_t buttons = 0;
+            for (uint8_t bit = 0; bit < XINPUT_BUTTON_COUNT; bit++) {
+                const uint8_t pin = pins[bit];
+                if (pin != XINPUT_PIN_NONE && pin / 8 == bank_byte && (value >> (pin % 8)) & 1) {
+                    buttons |= (uint16_t)(1u << bit);
+                }
+            }
+            map.lut[bank_byte][value] = buttons;
+        }
+    }
+    return map;
+}
+
+static inline uint16_t xinput_button_remap_apply(const xinput_button_remap_t *map, uint32_t gpio) {
+    return map->lut[0][gpio & 0xFF] | map->lut[1][(gpio >> 8) & 0xFF] |
+           map->lut[2][(gpio >> 16) & 0xFF] | map->lut[3][gpio >> 24];
+}
+
+#endif /* XINPUT_REPORT_HPP_ */
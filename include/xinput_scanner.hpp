@@ -0,0 +1,94 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef XINPUT_SCANNER_HPP_
+#define XINPUT_SCANNER_HPP_
+
+#include "xinput_report.hpp"
+
+#include <stdint.h>
+
+#ifdef ARDUINO_ARCH_RP2040
+#include <pico/time.h>
+#endif
+
+// Debounced scanning of a 32-bit GPIO bank into the XInput button word. All
+// inputs are debounced in parallel with a 2-bit vertical counter: a bit of the
+// debounced state flips once the raw input has differed from it for 4
+// consecutive scans, and any agreeing scan resets that bit's count. A scan
+// costs the same handful of logic operations plus the four remap lookups no
+// matter how many buttons are wired.
+
+typedef struct {
+    const xinput_button_remap_t *remap;
+    uint32_t invert; // GPIO bits that read 0 when pressed, e.g. with pull-ups
+
+    uint32_t state; // debounced, 1 = pressed
+    uint32_t count0;
+    uint32_t count1;
+    uint16_t buttons;
+
+#ifdef ARDUINO_ARCH_RP2040
+    repeating_timer_t timer;
+#endif
+} xinput_scanner_t;
+
+// Inputs start out released. GPIO bits not referenced by remap are ignored.
+void xinput_scanner_init(
+    xinput_scanner_t *scanner,
+    const xinput_button_remap_t *remap,
+    uint32_t invert
+);
+
+// Feeds one raw sample of the bank and returns the debounced button word
+static inline uint16_t xinput_scanner_update(xinput_scanner_t *scanner, uint32_t gpio) {
+    const uint32_t delta = (gpio ^ scanner->invert) ^ scanner->state;
+
+    scanner->count1 = (scanner->count1 ^ scanner->count0) & delta;
+    scanner->count0 = ~scanner->count0 & delta;
+    scanner->state ^= delta & ~(scanner->count0 | scanner->count1);
+
+    // Atomic so xinput_scanner_buttons() can be called from other contexts
+    const uint16_t buttons = xinput_button_remap_apply(scanner->remap, scanner->state);
+    __atomic_store_n(&scanner->buttons, buttons, __ATOMIC_RELAXED);
+    return buttons;
+}
+
+// Latest debounced button word, safe to call from any context
+static inline uint16_t xinput_scanner_buttons(const xinput_scanner_t *scanner) {
+    return __atomic_load_n(&scanner->buttons, __ATOMIC_RELAXED);
+}
+
+#ifdef ARDUINO_ARCH_RP2040
+// Samples all GPIOs with a single SIO register read. Call it at a fixed rate,
+// e.g. from the latch callback or with xinput_scanner_start().
+uint16_t xinput_scanner_scan(xinput_scanner_t *scanner);
+
+// Scans every period_us from a repeating timer alarm on the calling core
+bool xinput_scanner_start(xinput_scanner_t *scanner, uint32_t period_us);
+
+void xinput_scanner_stop(xinput_scanner_t *scanner);
+#endif
+
+#endif /* XINPUT_SCANNER_HPP_ */
@@ -0,0 +1,117 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef XINPUT_TRACE_HPP_
+#define XINPUT_TRACE_HPP_
+
+#include <stdint.h>
+
+#ifdef ARDUINO_ARCH_RP2040
+#include <hardware/structs/timer.h>
+#else
+#include <Arduino.h>
+#endif
+
+// Event trace of the USB path. Each event is a timestamped 8 byte entry in a
+// fixed-size ring shared by all instances, safe to record from interrupts and
+// either core. Set CFG_XINPUT_TRACE to the ring size, a power of two, to
+// enable it; with 0 every XINPUT_TRACE() compiles to nothing.
+//
+// Dump with xinput_trace_dump() and convert the raw entries with
+// scripts/trace_to_chrome.py to view them in chrome://tracing or Perfetto.
+
+#ifndef CFG_XINPUT_TRACE
+#define CFG_XINPUT_TRACE 0
+#endif
+
+static_assert(
+    (CFG_XINPUT_TRACE & (CFG_XINPUT_TRACE - 1)) == 0,
+    "CFG_XINPUT_TRACE must be 0 or a power of two"
+);
+
+enum {
+    XINPUT_TRACE_SEND = 1,     // report queued, arg 1 if suppressed as unchanged
+    XINPUT_TRACE_IN_ARMED,     // IN transfer started
+    XINPUT_TRACE_IN_COMPLETE,  // IN transfer ended, arg is the xfer_result_t, 0 if read
+    XINPUT_TRACE_OUT_RECEIVED, // arg is the packet length
+    XINPUT_TRACE_SOF,          // arg is the low 16 bits of the frame number
+    XINPUT_TRACE_RESET,        // bus reset or disconnect
+    XINPUT_TRACE_CONTROL,      // vendor request, arg is bRequest | 0x100 if stalled
+
+    // First event number available to the application
+    XINPUT_TRACE_USER = 0x80,
+};
+
+// Instance of events that are not specific to one controller
+#define XINPUT_TRACE_ANY 0xFF
+
+// Little-endian on the wire, as dumped
+typedef struct {
+    uint32_t time_us;
+    uint8_t event;
+    uint8_t instance;
+    uint16_t arg;
+} xinput_trace_entry_t;
+
+static_assert(sizeof(xinput_trace_entry_t) == 8, "trace entry layout");
+
+#if CFG_XINPUT_TRACE
+
+extern xinput_trace_entry_t _xinput_trace_ring[CFG_XINPUT_TRACE];
+extern uint32_t _xinput_trace_count;
+
+static inline void xinput_trace(uint8_t event, uint8_t instance, uint16_t arg) {
+    const uint32_t index = __atomic_fetch_add(&_xinput_trace_count, 1, __ATOMIC_RELAXED);
+    xinput_trace_entry_t *entry = &_xinput_trace_ring[index & (CFG_XINPUT_TRACE - 1)];
+
+#ifdef ARDUINO_ARCH_RP2040
+    // Raw low word of the 1 MHz timer, cheaper than micros()
+    entry->time_us = timer_hw->timerawl;
+#else
+    entry->time_us = micros();
+#endif
+    entry->event = event;
+    entry->instance = instance;
+    entry->arg = arg;
+}
+
+// Copies up to max entries, oldest first, and returns how many were copied.
+// Entries recorded while copying may be torn.
+uint32_t xinput_trace_dump(xinput_trace_entry_t *dst, uint32_t max);
+
+// Total number of events recorded, including those overwritten since
+static inline uint32_t xinput_trace_count(void) {
+    return __atomic_load_n(&_xinput_trace_count, __ATOMIC_RELAXED);
+}
+
+#define XINPUT_TRACE(_event, _instance, _arg) xinput_trace(_event, _instance, _arg)
+
+#else
+
+#define XINPUT_TRACE(_event, _instance, _arg)
+
+#endif
+
+#endif /* XINPUT_TRACE_HPP_ */
@@ -0,0 +1,90 @@
+# Post-build size check for PlatformIO environments.
+#
+# Reports flash and RAM use of the firmware and fails the build when either
+# grows past the size recorded for the environment in scripts/size_budget.json
+# by more than custom_size_tolerance bytes:
+#
+#   extra_scripts = post:scripts/check_size.py
+#   custom_size_tolerance = <bytes>
+#
+# The budget is measured, not estimated: building with XINPUT_SIZE_RECORD=1
+# set in the environment records the sizes of the environment, for a new one
+# or after an intended change. Commit the updated file together with that
+# change. Without it the file is only read, and an environment that has no
+# entry fails the build like one that grew.
+#
+# Sections are classified with the same regular expressions PlatformIO uses
+# for its own size summary.
+
+import json
+import os
+import re
+import subprocess
+
+Import("env")  # noqa: F821 (provided by SCons)
+
+FLASH_SECTIONS = env.get(
+    "SIZEPROGREGEXP", r"^(?:\.text|\.data|\.rodata|\.text.align|\.ARM.exidx)\s+(\d+).*")
+RAM_SECTIONS = env.get("SIZEDATAREGEXP", r"^(?:\.data|\.bss|\.noinit)\s+(\d+).*")
+
+BUDGET_FILE = os.path.join(env.subst("$PROJECT_DIR"), "scripts", "size_budget.json")
+
+
+def section_total(output, pattern):
+    regex = re.compile(pattern)
+    total = 0
+    for line in output.splitlines():
+        match = regex.search(line)
+        if match:
+            total += int(match.group(1))
+    return total
+
+
+def load_budgets():
+    if not os.path.exists(BUDGET_FILE):
+        return {}
+    with open(BUDGET_FILE) as f:
+        return json.load(f)
+
+
+def save_budgets(budgets):
+    with open(BUDGET_FILE, "w") as f:
+        json.dump(budgets, f, indent=4, sort_keys=True)
+        f.write("\n")
+
+
+def check_size(source, target, env):
+    elf = str(target[0])
+    output = subprocess.check_output([env.subst("$SIZETOOL"), "-A", "-d", elf]).decode()
+    used = {
+        "flash": section_total(output, FLASH_SECTIONS),
+        "ram": section_total(output, RAM_SECTIONS),
+    }
+
+    name = env.subst("$PIOENV")
+    budgets = load_budgets()
+    if os.environ.get("XINPUT_SIZE_RECORD") == "1":
+        budgets[name] = used
+        save_budgets(budgets)
+        print("Recorded size budget of %s: flash %d, RAM %d bytes"
+              % (name, used["flash"], used["ram"]))
+        return 0
+
+    if name not in budgets:
+        print("No size budget recorded for %s in %s, build with XINPUT_SIZE_RECORD=1 to "
+              "record one" % (name, BUDGET_FILE))
+        return 1
+
+    tolerance = int(env.GetProjectOption("custom_size_tolerance", "0"))
+    failed = False
+    for key, label in (("flash", "Flash"), ("ram", "RAM")):
+        budget = budgets[name][key]
+        print("%s: %d of %d bytes recorded (%+d)" % (label, used[key], budget, used[key] - budget))
+        if used[key] > budget + tolerance:
+            print("%s use grew past the recorded budget, see %s" % (label, BUDGET_FILE))
+            failed = True
+
+    return 1 if failed else 0
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", check_size)
@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+# Converts a raw XInput trace dump into Chrome trace event JSON, viewable in
+# chrome://tracing or https://ui.perfetto.dev.
+#
+# The input is the array filled by xinput_trace_dump() written out as is:
+# 8 byte little-endian entries of (time_us: u32, event: u8, instance: u8,
+# arg: u16), oldest first. IN transfers become spans from arming to completion
+# on one track per controller, all other events are instants.
+#
+#   python3 scripts/trace_to_chrome.py trace.bin > trace.json
+
+import argparse
+import json
+import struct
+import sys
+
+ENTRY = struct.Struct("<IBBH")
+
+EVENTS = {
+    1: "send",
+    2: "in_armed",
+    3: "in_complete",
+    4: "out_received",
+    5: "sof",
+    6: "reset",
+    7: "control",
+}
+
+TRACE_USER = 0x80
+TRACE_ANY = 0xFF
+
+# Events recorded concurrently can be stored a few microseconds out of order,
+# only a step back by more than half the range is the 32-bit timer wrapping
+WRAP_THRESHOLD = 1 << 31
+
+
+def read_entries(data):
+    usable = len(data) - len(data) % ENTRY.size
+    # Unwrap the 32-bit microsecond timestamps
+    epoch = 0
+    previous = None
+    for offset in range(0, usable, ENTRY.size):
+        time_us, event, instance, arg = ENTRY.unpack_from(data, offset)
+        if previous is not None and previous - time_us > WRAP_THRESHOLD:
+            epoch += 1 << 32
+        elif previous is not None and time_us - previous > WRAP_THRESHOLD:
+            # out of order across a wrap, belongs to the previous epoch
+            yield epoch - (1 << 32) + time_us, event, instance, arg
+            continue
+        previous = time_us
+        yield epoch + time_us, event, instance, arg
+
+
+def event_name(event):
+    if event >= TRACE_USER:
+        return "user_%d" % (event - TRACE_USER)
+    return EVENTS.get(event, "event_%d" % event)
+
+
+def convert(entries):
+    trace = []
+    armed = {}
+    start = None
+
+    for time_us, event, instance, arg in entries:
+        if start is None:
+            start = time_us
+        ts = time_us - start
+        tid = "usb" if instance == TRACE_ANY else "xinput %d" % instance
+
+        if event == 2:
+            armed[instance] = ts
+            continue
+
+        if event == 3 and instance in armed:
+            begin = armed.pop(instance)
+            trace.append({"name": "IN transfer", "ph": "X", "ts": begin, "dur": max(ts - begin, 0),
+                          "pid": 1, "tid": tid})
+            continue
+
+        args = {"arg": arg}
+        if event == 7:
+            args = {"bRequest": arg & 0xFF, "stalled": bool(arg & 0x100)}
+        trace.append({"name": event_name(event), "ph": "i", "s": "t", "ts": ts,
+                      "pid": 1, "tid": tid, "args": args})
+
+    return {"traceEvents": trace, "displayTimeUnit": "ms"}
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Convert an XInput trace dump to Chrome trace JSON")
+    parser.add_argument("dump", help="raw trace dump")
+    parser.add_argument("-o", "--output", help="output file, default stdout")
+    args = parser.parse_args()
+
+    with open(args.dump, "rb") as f:
+        result = convert(read_entries(f.read()))
+
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(result, f)
+    else:
+        json.dump(result, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
@@ -23,103 +23,263 @@
  */
 
 #include "Adafruit_USBD_XInput.hpp"
+#include "xinput_descriptors.hpp"
+#include "xinput_recorder.hpp"
+#include "xinput_trace.hpp"
 
 #include "device/usbd_pvt.h"
 #include "tusb_option.h"
 
+#include <Arduino.h>
+
+#ifdef ARDUINO_ARCH_RP2040
+#include <pico/time.h>
+#endif
+
+#ifdef ARDUINO_ARCH_ESP32
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
 enum {
     VENDOR_REQUEST_MICROSOFT = 1, // bRequest value to be used by control transfers
 };
 
-// TODO multiple instances
-static Adafruit_USBD_XInput *_xinput_dev = NULL;
+static Adafruit_USBD_XInput *_xinput_devs[CFG_XINPUT_MAX_INSTANCES] = {};
+static uint8_t _xinput_dev_count = 0;
+
+// Maps endpoint number and direction to instance index + 1 (0 = not ours),
+// indexed by XINPUT_EP_MAP_INDEX
+static uint8_t _xinput_ep_map[32] = {};
+
+#define XINPUT_EP_MAP_INDEX(_ep_addr) (((_ep_addr) & 0x0F) | (((_ep_addr) & 0x80) >> 3))
+
+#define XINPUT_REPORT_PENDING 0x80
+#define XINPUT_REPORT_INDEX_MASK 0x03
+
+#define XINPUT_FRAME_US 1000
 
-#define BOS_TOTAL_LEN (TUD_BOS_DESC_LEN + TUD_BOS_MICROSOFT_OS_DESC_LEN)
+#if CFG_XINPUT_STATS
+#define XINPUT_STATS(_expr) _expr
+#else
+#define XINPUT_STATS(_expr)
+#endif
+
+// Interface descriptor template, the interface number, endpoint addresses and
+// polling interval are filled in when it is copied out
+static constexpr auto desc_xinput_itf = xinput_interface_desc(0, EPOUT, EPIN, 1);
+
+static_assert(
+    desc_xinput_itf.data[XINPUT_ITF_DESC_EPIN_OFFSET] == EPIN &&
+        desc_xinput_itf.data[XINPUT_ITF_DESC_EPOUT_OFFSET] == EPOUT &&
+        desc_xinput_itf.data[XINPUT_ITF_DESC_INTERVAL_OFFSET] == 1,
+    "XInput interface descriptor field offsets"
+);
 
-#define MS_OS_20_DESC_LEN 0xB2
+#ifdef CFG_XINPUT_FIRST_ITF
+
+// With a fixed interface layout the whole MS OS 2.0 set is generated at
+// compile time. All CFG_XINPUT_MAX_INSTANCES instances must be begun, in order,
+// as interfaces CFG_XINPUT_FIRST_ITF onwards.
+static constexpr auto desc_ms_os_20 =
+    xinput_ms_os_20_desc<CFG_XINPUT_FIRST_ITF, CFG_XINPUT_MAX_INSTANCES>();
 
 // BOS Descriptor is required for automatic driver instalaltion
-const uint8_t desc_bos[] = {
-    // total length, number of device caps
-    TUD_BOS_DESCRIPTOR(BOS_TOTAL_LEN, 1),
-    // Microsoft OS 2.0 descriptor
-    TUD_BOS_MS_OS_20_DESCRIPTOR(MS_OS_20_DESC_LEN, VENDOR_REQUEST_MICROSOFT)
+static constexpr auto desc_bos =
+    xinput_bos_desc(desc_ms_os_20.length, VENDOR_REQUEST_MICROSOFT);
+
+static_assert(
+    desc_ms_os_20.length == XINPUT_MS_OS_20_HEADER_LEN +
+                                CFG_XINPUT_MAX_INSTANCES * XINPUT_MS_OS_20_FUNCTION_LEN,
+    "MS OS 2.0 descriptor set length"
+);
+
+#else
+
+// Function subset template, copied once per instance with bFirstInterface set
+// to the interface the instance was given
+static constexpr auto desc_ms_os_20_function = xinput_ms_os_20_function(0);
+
+// MS OS 2.0 set assembled in xinput_update_ms_os_20() as instances are added.
+// BOS Descriptor is required for automatic driver instalaltion, its set length
+// follows the assembled set.
+static xinput_desc_t<XINPUT_MS_OS_20_DESC_LEN(CFG_XINPUT_MAX_INSTANCES)> desc_ms_os_20 = {};
+static xinput_desc_t<XINPUT_BOS_DESC_LEN> desc_bos =
+    xinput_bos_desc(XINPUT_MS_OS_20_DESC_LEN(1), VENDOR_REQUEST_MICROSOFT);
+
+#endif
+
+//--------------------------------------------------------------------+
+// Vendor control responses
+//--------------------------------------------------------------------+
+
+// Capability reports of a wired Xbox 360 controller, requested by the XUSB
+// driver and consoles during enumeration. The input capabilities mark every
+// report field as supported, the output capabilities both rumble motors.
+static const uint8_t xinput_input_capabilities[] = {
+    0x00, 0x14, 0xFF, 0xF7, 0xFF, 0xFF, 0xC0, 0xFF, 0xC0, 0xFF,
+    0xC0, 0xFF, 0xC0, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+static const uint8_t xinput_output_capabilities[] = {
+    0x00, 0x08, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0x00,
+};
+static const uint8_t xinput_serial_number[] = { 0x00, 0x00, 0x00, 0x00 };
+
+// Matches any wIndex, used for interface requests where it is the interface
+#define XINPUT_CONTROL_ANY_INDEX 0xFFFF
+
+typedef struct {
+    uint8_t bmRequestType;
+    uint8_t bRequest;
+    uint16_t wValue;
+    uint16_t wIndex;
+    const uint8_t *data;
+    uint16_t length; // 0 for an MS OS 2.0 set, whose length is in its header
+} xinput_control_response_t;
+
+static const xinput_control_response_t xinput_control_responses[] = {
+    // Microsoft OS 2.0 descriptor set, device recipient
+    { 0xC0, VENDOR_REQUEST_MICROSOFT, 0x0000, 0x0007, desc_ms_os_20.data, 0 },
+    // Serial number, device recipient
+    { 0xC0, 0x01, 0x0000, 0x0000, xinput_serial_number, sizeof(xinput_serial_number) },
+    // Input and output capabilities, interface recipient
+    { 0xC1,
+      0x01,
+      0x0100,
+      XINPUT_CONTROL_ANY_INDEX,
+      xinput_input_capabilities,
+      sizeof(xinput_input_capabilities) },
+    { 0xC1,
+      0x01,
+      0x0000,
+      XINPUT_CONTROL_ANY_INDEX,
+      xinput_output_capabilities,
+      sizeof(xinput_output_capabilities) },
 };
 
-// clang-format off
-
-uint8_t desc_ms_os_20[MS_OS_20_DESC_LEN] = {
-    // Set header: length, type, windows version, total length
-    U16_TO_U8S_LE(0x000A), U16_TO_U8S_LE(MS_OS_20_SET_HEADER_DESCRIPTOR),
-    U32_TO_U8S_LE(0x06030000), U16_TO_U8S_LE(MS_OS_20_DESC_LEN),
-
-    // Configuration subset header: length, type, configuration index, reserved,
-    // configuration total length
-    U16_TO_U8S_LE(0x0008), U16_TO_U8S_LE(MS_OS_20_SUBSET_HEADER_CONFIGURATION),
-    0, 0, U16_TO_U8S_LE(MS_OS_20_DESC_LEN - 0x0A),
-
-    // Function Subset header: length, type, first interface, reserved, subset
-    // length
-    U16_TO_U8S_LE(0x0008), U16_TO_U8S_LE(MS_OS_20_SUBSET_HEADER_FUNCTION),
-    0 /*itf num*/, 0, U16_TO_U8S_LE(MS_OS_20_DESC_LEN - 0x0A - 0x08),
-
-    // MS OS 2.0 Compatible ID descriptor: length, type, compatible ID, sub
-    // compatible ID
-    U16_TO_U8S_LE(0x0014), U16_TO_U8S_LE(MS_OS_20_FEATURE_COMPATBLE_ID), 'X',
-    'U', 'S', 'B', '2', '0', 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, // sub-compatible
-
-    // MS OS 2.0 Registry property descriptor: length, type
-    U16_TO_U8S_LE(MS_OS_20_DESC_LEN - 0x0A - 0x08 - 0x08 - 0x14),
-    U16_TO_U8S_LE(MS_OS_20_FEATURE_REG_PROPERTY), U16_TO_U8S_LE(0x0007),
-    U16_TO_U8S_LE(0x002A), // wPropertyDataType, wPropertyNameLength and
-                           // PropertyName "DeviceInterfaceGUIDs\0" in UTF-16
-    'D', 0x00, 'e', 0x00, 'v', 0x00, 'i', 0x00, 'c', 0x00, 'e', 0x00, 'I', 0x00,
-    'n', 0x00, 't', 0x00, 'e', 0x00, 'r', 0x00, 'f', 0x00, 'a', 0x00, 'c', 0x00,
-    'e', 0x00, 'G', 0x00, 'U', 0x00, 'I', 0x00, 'D', 0x00, 's', 0x00, 0x00,
-    0x00,
-    U16_TO_U8S_LE(0x0050), // wPropertyDataLength
-    // bPropertyData: "{8D90842C-1594-41CE-AA3F-62D464E1BE79}".
-    '{', 0x00, '8', 0x00, 'D', 0x00, '9', 0x00, '0', 0x00, '8', 0x00, '4', 0x00,
-    '2', 0x00, 'C', 0x00, '-', 0x00, '1', 0x00, '5', 0x00, '9', 0x00, '4', 0x00,
-    '-', 0x00, '4', 0x00, '1', 0x00, 'C', 0x00, 'E', 0x00, '-', 0x00, 'A', 0x00,
-    'A', 0x00, '3', 0x00, 'F', 0x00, '-', 0x00, '6', 0x00, '2', 0x00, 'D', 0x00,
-    '4', 0x00, '6', 0x00, '4', 0x00, 'E', 0x00, '1', 0x00, 'B', 0x00, 'E', 0x00,
-    '7', 0x00, '9', 0x00, '}', 0x00, 0x00, 0x00, 0x00, 0x00};
-
-// clang-format on
+// Answers a SETUP stage from the response table, returns false to stall
+static bool xinput_control_respond(uint8_t rhport, const tusb_control_request_t *request) {
+    for (const xinput_control_response_t &response : xinput_control_responses) {
+        if (response.bmRequestType != request->bmRequestType ||
+            response.bRequest != request->bRequest || response.wValue != request->wValue ||
+            (response.wIndex != XINPUT_CONTROL_ANY_INDEX && response.wIndex != request->wIndex)) {
+            continue;
+        }
+
+        const uint16_t length =
+            response.length ? response.length : tu_u16(response.data[9], response.data[8]);
+        return tud_control_xfer(rhport, request, (void *)response.data, length);
+    }
+
+    return false;
+}
+
+void xinput_update_ms_os_20(void) {
+#ifndef CFG_XINPUT_FIRST_ITF
+    const uint16_t total_len = XINPUT_MS_OS_20_DESC_LEN(_xinput_dev_count);
+
+    const auto header = xinput_ms_os_20_header(total_len);
+    memcpy(desc_ms_os_20.data, header.data, header.length);
+
+    uint8_t *function = desc_ms_os_20.data + header.length;
+    for (uint8_t i = 0; i < _xinput_dev_count; i++) {
+        memcpy(function, desc_ms_os_20_function.data, desc_ms_os_20_function.length);
+        // update the bFirstInterface that is bound to XUSB driver
+        function[XINPUT_MS_OS_20_FUNCTION_ITFNUM_OFFSET] = _xinput_devs[i]->_itfnum;
+        function += desc_ms_os_20_function.length;
+    }
+
+    desc_bos.data[XINPUT_BOS_MS_OS_20_LEN_OFFSET] = TU_U16_LOW(total_len);
+    desc_bos.data[XINPUT_BOS_MS_OS_20_LEN_OFFSET + 1] = TU_U16_HIGH(total_len);
+#endif
+}
+
+static void xinput_copy_itf_desc(
+    uint8_t *dst,
+    uint8_t itfnum,
+    uint8_t ep_out,
+    uint8_t ep_in,
+    uint8_t interval_ms
+) {
+    memcpy(dst, desc_xinput_itf.data, desc_xinput_itf.length);
+    dst[XINPUT_ITF_DESC_ITFNUM_OFFSET] = itfnum;
+    dst[XINPUT_ITF_DESC_EPIN_OFFSET] = ep_in;
+    dst[XINPUT_ITF_DESC_INTERVAL_OFFSET] = interval_ms;
+    dst[XINPUT_ITF_DESC_EPOUT_OFFSET] = ep_out;
+}
+
+bool xinput_register(Adafruit_USBD_XInput *dev) {
+    if (dev->_instance < _xinput_dev_count) {
+        return true;
+    }
+    TU_VERIFY(_xinput_dev_count < CFG_XINPUT_MAX_INSTANCES);
+
+    dev->_instance = _xinput_dev_count;
+    _xinput_devs[_xinput_dev_count++] = dev;
+    return true;
+}
+
+static inline Adafruit_USBD_XInput *xinput_dev_for_ep(uint8_t ep_addr) {
+    const uint8_t slot = _xinput_ep_map[XINPUT_EP_MAP_INDEX(ep_addr)];
+    return slot ? _xinput_devs[slot - 1] : NULL;
+}
+
+static inline Adafruit_USBD_XInput *xinput_dev(uint8_t instance) {
+    return instance < _xinput_dev_count ? _xinput_devs[instance] : NULL;
+}
 
 #ifdef ARDUINO_ARCH_ESP32
-static uint16_t xinput_load_descriptor(uint8_t *dst, uint8_t *itf) {
-    // uint8_t str_index = tinyusb_add_string_descriptor("TinyUSB XInput");
-    uint8_t str_index = 0;
+uint16_t xinput_load_descriptor(uint8_t *dst, uint8_t *itf) {
+    // Interfaces are loaded in the order the instances were constructed
+    Adafruit_USBD_XInput *dev = NULL;
+    for (uint8_t i = 0; i < _xinput_dev_count && !dev; i++) {
+        if (_xinput_devs[i]->_itfnum == 0xFF) {
+            dev = _xinput_devs[i];
+        }
+    }
+    TU_VERIFY(dev, 0);
 
     uint8_t ep_in = tinyusb_get_free_in_endpoint();
     uint8_t ep_out = tinyusb_get_free_out_endpoint();
     TU_VERIFY(ep_in && ep_out);
     ep_in |= EPIN;
 
-    const uint8_t descriptor[TUD_XINPUT_DESC_LEN] = {
-        // Interface number, string index, EP Out & EP In address, EP size
-        TUD_XINPUT_DESCRIPTOR(*itf, str_index, ep_out, ep_in, EPSIZE, 1)
-    };
+    xinput_copy_itf_desc(dst, *itf, ep_out, ep_in, dev->_interval_ms);
+
+    dev->_itfnum = *itf;
+    xinput_update_ms_os_20();
 
     *itf += 1;
-    memcpy(dst, descriptor, TUD_XINPUT_DESC_LEN);
     return TUD_XINPUT_DESC_LEN;
 }
 #endif
 
 //------------- IMPLEMENTATION -------------//
 
+// Records a startup milestone the first time it is reached
+static inline void xinput_startup_mark(uint32_t *milestone) {
+    if (!*milestone) {
+        // 0 means not reached, a milestone at exactly 0 us moves by 1 us
+        __atomic_store_n(milestone, micros() | 1, __ATOMIC_RELEASE);
+    }
+}
+
 Adafruit_USBD_XInput::Adafruit_USBD_XInput(uint8_t interval_ms) {
-    _interval_ms = interval_ms;
+    xinput_startup_mark(&_startup.constructed_us);
+    // An interrupt endpoint interval of 0 is invalid, and the latch divides
+    // by it
+    _interval_ms = interval_ms ? interval_ms : 1;
+
+    for (uint8_t i = 0; i < CFG_XINPUT_OUT_QUEUE; i++) {
+        _out_ring[i] = i;
+    }
 
 #ifdef ARDUINO_ARCH_ESP32
     // ESP32 requires setup configuration descriptor within constructor
-    _xinput_dev = this;
-    const uint16_t desc_len = getInterfaceDescriptor(0, NULL, 0);
-    tinyusb_enable_interface(USB_INTERFACE_VENDOR, desc_len, xinput_load_descriptor);
+    if (xinput_register(this)) {
+        const uint16_t desc_len = getInterfaceDescriptor(0, NULL, 0);
+        tinyusb_enable_interface(USB_INTERFACE_VENDOR, desc_len, xinput_load_descriptor);
+    }
 #endif
 }
 
@@ -128,81 +288,480 @@ uint16_t Adafruit_USBD_XInput::getInterfaceDescriptor(
     uint8_t *buf,
     uint16_t bufsize
 ) {
-    // usb core will automatically update endpoint number
-    const uint8_t desc[] = { TUD_XINPUT_DESCRIPTOR(itfnum, 0, EPOUT, EPIN, EPSIZE, _interval_ms) };
-    const uint16_t len = sizeof(desc);
+    const uint16_t len = desc_xinput_itf.length;
 
     if (bufsize < len) {
         return 0;
     }
 
-    memcpy(buf, desc, len);
+#ifdef CFG_XINPUT_FIRST_ITF
+    // the MS OS 2.0 set was generated for a fixed interface layout
+    TU_VERIFY(itfnum == CFG_XINPUT_FIRST_ITF + _instance, 0);
+#endif
+
+    // usb core will automatically update endpoint number
+    xinput_copy_itf_desc(buf, itfnum, EPOUT, EPIN, _interval_ms);
 
-    // update the bFirstInterface in MS OS 2.0 descriptor
-    // that is bound to XUSB driver
-    desc_ms_os_20[0x0a + 0x08 + 4] = itfnum;
+    // rebuild the MS OS 2.0 descriptor so its function subset for this
+    // instance is bound to the right interface
+    _itfnum = itfnum;
+    xinput_update_ms_os_20();
 
     return len;
 }
 
 bool Adafruit_USBD_XInput::begin(void) {
+    xinput_startup_mark(&_startup.begun_us);
+    TU_VERIFY(xinput_register(this));
+
     if (!TinyUSBDevice.addInterface(*this)) {
         return false;
     }
 
     TinyUSBDevice.setVersion(0x0210);
 
-    _xinput_dev = this;
     return true;
 }
 
 bool Adafruit_USBD_XInput::ready(void) {
-    return tud_xinput_ready();
+    return tud_xinput_n_ready(_instance);
+}
+
+bool Adafruit_USBD_XInput::sendReport(const xinput_report_t *report) {
+    return send_xinput_n_report(_instance, report);
+}
+
+bool Adafruit_USBD_XInput::publishReport(const xinput_report_t *report) {
+    return publish_xinput_n_report(_instance, report);
+}
+
+bool Adafruit_USBD_XInput::flush(void) {
+    return flush_xinput_n_report(_instance);
+}
+
+void Adafruit_USBD_XInput::setLatchCallback(xinput_latch_cb_t callback, uint16_t lead_us) {
+    _latch_lead_us = lead_us;
+    _latch_cb = callback;
+}
+
+void Adafruit_USBD_XInput::setChangeDetection(bool enabled, uint16_t keepalive_ms) {
+    _keepalive_ms = keepalive_ms;
+    _change_detection = enabled;
+}
+
+bool Adafruit_USBD_XInput::suspended(void) {
+    return tud_suspended();
+}
+
+bool Adafruit_USBD_XInput::waitResume(uint32_t timeout_ms) {
+#if defined(ARDUINO_ARCH_RP2040)
+    // The USB interrupt raised by resume signalling ends the WFE
+    const absolute_time_t timeout = make_timeout_time_ms(timeout_ms);
+    while (tud_suspended()) {
+        if (best_effort_wfe_or_timeout(timeout)) {
+            return !tud_suspended();
+        }
+    }
+    return true;
+#else
+    const uint32_t start_ms = millis();
+    while (tud_suspended()) {
+        if (millis() - start_ms >= timeout_ms) {
+            return false;
+        }
+        delay(1);
+    }
+    return true;
+#endif
+}
+
+bool Adafruit_USBD_XInput::idle(void) {
+    return _idle_timeout_ms && millis() - _last_change_ms >= _idle_timeout_ms;
+}
+
+bool Adafruit_USBD_XInput::getRumble(uint8_t *left, uint8_t *right) {
+    const uint16_t rumble = __atomic_load_n(&_rumble, __ATOMIC_ACQUIRE);
+    *left = TU_U16_LOW(rumble);
+    *right = TU_U16_HIGH(rumble);
+    return __atomic_exchange_n(&_rumble_updated, false, __ATOMIC_ACQ_REL);
+}
+
+uint8_t Adafruit_USBD_XInput::outQueueTail(void) {
+    uint8_t tail = _out_tail;
+
+    // Drop what a bus reset flushed since the last call, unless the reader
+    // has already read past that point
+    const uint8_t gen = __atomic_load_n(&_out_flush_gen, __ATOMIC_ACQUIRE);
+    if (gen != _out_flush_seen) {
+        _out_flush_seen = gen;
+        const uint8_t flush_head = __atomic_load_n(&_out_flush_head, __ATOMIC_RELAXED);
+        const uint8_t head = __atomic_load_n(&_out_head, __ATOMIC_ACQUIRE);
+        if ((uint8_t)(flush_head - tail) <= (uint8_t)(head - tail)) {
+            tail = flush_head;
+            __atomic_store_n(&_out_tail, tail, __ATOMIC_RELEASE);
+        }
+    }
+    return tail;
+}
+
+uint8_t Adafruit_USBD_XInput::outPacketsAvailable(void) {
+    const uint8_t tail = outQueueTail();
+    return (uint8_t)(__atomic_load_n(&_out_head, __ATOMIC_ACQUIRE) - tail);
+}
+
+uint16_t Adafruit_USBD_XInput::readOutPacket(uint8_t *buf, uint16_t bufsize) {
+    const uint8_t tail = outQueueTail();
+    if (__atomic_load_n(&_out_head, __ATOMIC_ACQUIRE) == tail) {
+        return 0;
+    }
+
+    const uint8_t buffer = _out_ring[tail % CFG_XINPUT_OUT_QUEUE];
+    const uint16_t len = _out_length[buffer] < bufsize ? _out_length[buffer] : bufsize;
+    memcpy(buf, _out_buffers[buffer], len);
+
+    // Hand the slot back to the USB task only after the copy
+    __atomic_store_n(&_out_tail, (uint8_t)(tail + 1), __ATOMIC_RELEASE);
+    return len;
+}
+
+void Adafruit_USBD_XInput::handleOutReport(const uint8_t *data, uint16_t len) {
+    if (_out_report_cb) {
+        _out_report_cb(data, len);
+    }
+
+    // Byte 0 is the message type, byte 1 the message length
+    if (len < 2 || data[1] > len) {
+        return;
+    }
+
+    switch (data[0]) {
+        case XINPUT_OUT_RUMBLE:
+            // 00 08 00 <left> <right> 00 00 00
+            if (data[1] >= 5) {
+                __atomic_store_n(&_rumble, tu_u16(data[4], data[3]), __ATOMIC_RELEASE);
+                __atomic_store_n(&_rumble_updated, true, __ATOMIC_RELEASE);
+                if (_rumble_cb) {
+                    _rumble_cb(data[3], data[4]);
+                }
+            }
+            break;
+
+        case XINPUT_OUT_LED:
+            // 01 03 <pattern>
+            if (data[1] >= 3) {
+                _led_pattern = data[2];
+                if (_led_cb) {
+                    _led_cb(data[2]);
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+void Adafruit_USBD_XInput::trackSuspend(bool suspended) {
+    // TinyUSB only reports suspend and resume to the application, so the
+    // transitions are noted as the producer sees them. The USB task does not
+    // run while suspended and records them later, see recordBusEvents().
+    if (suspended != _bus_suspended) {
+        _bus_suspended = suspended;
+        __atomic_store_n(suspended ? &_suspend_us : &_resume_us, micros() | 1, __ATOMIC_RELEASE);
+    }
+}
+
+void Adafruit_USBD_XInput::recordBusEvents(void) {
+    // Called from the USB task before anything else is recorded, so the log
+    // stays in time order
+    uint32_t suspend_us = __atomic_exchange_n(&_suspend_us, 0, __ATOMIC_ACQ_REL);
+    uint32_t resume_us = __atomic_exchange_n(&_resume_us, 0, __ATOMIC_ACQ_REL);
+    if (!_recorder || !(suspend_us || resume_us)) {
+        return;
+    }
+
+    // A resume still pending from the previous suspend goes first
+    uint8_t events[2] = { XINPUT_LOG_EVENT_SUSPEND, XINPUT_LOG_EVENT_RESUME };
+    uint32_t times[2] = { suspend_us, resume_us };
+    if (suspend_us && resume_us && (int32_t)(resume_us - suspend_us) < 0) {
+        events[0] = XINPUT_LOG_EVENT_RESUME;
+        events[1] = XINPUT_LOG_EVENT_SUSPEND;
+        times[0] = resume_us;
+        times[1] = suspend_us;
+    }
+
+    for (uint8_t i = 0; i < 2; i++) {
+        if (!times[i]) {
+            continue;
+        }
+        // The producer may have read the clock just before the USB task
+        // recorded something else, never step back behind that record
+        uint32_t time_us = times[i];
+        if (_recorder->length && (int32_t)(time_us - _recorder->last_us) < 0) {
+            time_us = _recorder->last_us;
+        }
+        xinput_recorder_event(_recorder, time_us, events[i]);
+    }
+}
+
+bool Adafruit_USBD_XInput::waitReportSent(uint32_t timeout_ms) {
+#if defined(ARDUINO_ARCH_RP2040)
+    const absolute_time_t timeout = make_timeout_time_ms(timeout_ms);
+    while (!__atomic_exchange_n(&_report_sent, false, __ATOMIC_ACQ_REL)) {
+        if (best_effort_wfe_or_timeout(timeout)) {
+            return false;
+        }
+    }
+    return true;
+#elif defined(ARDUINO_ARCH_ESP32)
+    // Register before checking the flag so a completion in between is not lost
+    __atomic_store_n(&_waiting_task, (void *)xTaskGetCurrentTaskHandle(), __ATOMIC_RELEASE);
+    bool sent = __atomic_exchange_n(&_report_sent, false, __ATOMIC_ACQ_REL);
+    if (!sent) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout_ms));
+        sent = __atomic_exchange_n(&_report_sent, false, __ATOMIC_ACQ_REL);
+    }
+    if (!__atomic_exchange_n(&_waiting_task, NULL, __ATOMIC_ACQ_REL)) {
+        // The completion took the handle, drop a notification it left pending
+        ulTaskNotifyTake(pdTRUE, 0);
+    }
+    return sent;
+#else
+    const uint32_t start_ms = millis();
+    while (!__atomic_exchange_n(&_report_sent, false, __ATOMIC_ACQ_REL)) {
+        if (millis() - start_ms >= timeout_ms) {
+            return false;
+        }
+        yield();
+    }
+    return true;
+#endif
+}
+
+uint32_t Adafruit_USBD_XInput::replay(const uint8_t *log, uint32_t length, bool realtime) {
+    // Do not record the replay into the log being played
+    xinput_recorder_t *recorder = _recorder;
+    _recorder = NULL;
+
+    xinput_log_reader_t reader;
+    xinput_log_record_t record;
+    uint32_t count = 0;
+    const uint32_t start_us = micros();
+
+    xinput_log_reader_init(&reader, log, length);
+    while (xinput_log_read(&reader, &record)) {
+        while (realtime && (int32_t)(micros() - start_us - record.time_us) < 0) {
+            yield();
+        }
+
+        switch (record.type) {
+            case XINPUT_LOG_REPORT:
+                sendReport(record.report);
+                break;
+
+            case XINPUT_LOG_OUT:
+                handleOutReport(record.data, record.length);
+                break;
+
+            default:
+                break;
+        }
+        count++;
+    }
+
+    _recorder = recorder;
+    return count;
+}
+
+#if CFG_XINPUT_STATS
+void Adafruit_USBD_XInput::getStats(xinput_stats_t *stats) {
+    memcpy(stats, &_stats, sizeof(xinput_stats_t));
 }
 
-bool Adafruit_USBD_XInput::sendReport(xinput_report_t *report) {
-    return send_xinput_report(report);
+void Adafruit_USBD_XInput::resetStats(void) {
+    memset(&_stats, 0, sizeof(xinput_stats_t));
 }
+#endif
 
-bool tud_xinput_ready() {
-    return _xinput_dev && _xinput_dev->_endpoint_in && tud_ready() &&
-           !usbd_edpt_busy(TUD_OPT_RHPORT, _xinput_dev->_endpoint_in);
+bool tud_xinput_n_ready(uint8_t instance) {
+    Adafruit_USBD_XInput *dev = xinput_dev(instance);
+    return dev && dev->_endpoint_in && tud_ready() &&
+           !usbd_edpt_busy(TUD_OPT_RHPORT, dev->_endpoint_in);
 }
 
-void receive_xinput_report(void) {
-    if (_xinput_dev && _xinput_dev->_endpoint_out && tud_ready() &&
-        !usbd_edpt_busy(TUD_OPT_RHPORT, _xinput_dev->_endpoint_out)) {
+void receive_xinput_n_report(uint8_t instance) {
+    Adafruit_USBD_XInput *dev = xinput_dev(instance);
+    if (dev && dev->_endpoint_out && tud_ready() &&
+        !usbd_edpt_busy(TUD_OPT_RHPORT, dev->_endpoint_out)) {
         // Take control of OUT endpoint
-        usbd_edpt_claim(TUD_OPT_RHPORT, _xinput_dev->_endpoint_out);
+        usbd_edpt_claim(TUD_OPT_RHPORT, dev->_endpoint_out);
         // Retrieve report buffer
         usbd_edpt_xfer(
             TUD_OPT_RHPORT,
-            _xinput_dev->_endpoint_out,
-            _xinput_dev->_xinput_out_buffer,
+            dev->_endpoint_out,
+            dev->_out_buffers[dev->_out_rx],
             EPSIZE
         );
         // Release control of OUT endpoint
-        usbd_edpt_release(TUD_OPT_RHPORT, _xinput_dev->_endpoint_out);
+        usbd_edpt_release(TUD_OPT_RHPORT, dev->_endpoint_out);
     }
 }
 
-bool send_xinput_report(xinput_report_t *report) {
-    bool sent = false;
+static bool xinput_report_equal(const xinput_report_t *a, const xinput_report_t *b) {
+    // Compare as 32-bit words, the report is 20 bytes with no alignment
+    // guarantee so go through memcpy
+    uint32_t diff = 0;
+    for (size_t i = 0; i < sizeof(xinput_report_t); i += sizeof(uint32_t)) {
+        uint32_t word_a, word_b;
+        memcpy(&word_a, (const uint8_t *)a + i, sizeof(uint32_t));
+        memcpy(&word_b, (const uint8_t *)b + i, sizeof(uint32_t));
+        diff |= word_a ^ word_b;
+    }
+    return diff == 0;
+}
 
-    // Is the device ready and is the IN endpoint available?
-    if (tud_xinput_ready()) {
-        // Take control of IN endpoint
-        usbd_edpt_claim(TUD_OPT_RHPORT, _xinput_dev->_endpoint_in);
-        // Send report buffer
-        usbd_edpt_xfer(
-            TUD_OPT_RHPORT,
-            _xinput_dev->_endpoint_in,
-            (uint8_t *)report,
-            sizeof(xinput_report_t)
-        );
-        // Release control of IN endpoint
-        usbd_edpt_release(TUD_OPT_RHPORT, _xinput_dev->_endpoint_in);
-        sent = true;
+bool send_xinput_n_report(uint8_t instance, const xinput_report_t *report) {
+    Adafruit_USBD_XInput *dev = xinput_dev(instance);
+    if (!dev) {
+        return false;
+    }
+
+    if (!dev->_endpoint_in) {
+        // Not configured yet or closed by a bus reset. The newest report is
+        // held and is what the host gets when the interface opens.
+        return publish_xinput_n_report(instance, report);
+    }
+
+    const bool suspended = tud_suspended();
+    dev->trackSuspend(suspended);
+
+    if (suspended) {
+        // Input changed while the host sleeps, wake it once. The report is
+        // not queued, the application resends it after resume.
+        if (!dev->_wakeup_requested && !xinput_report_equal(report, &dev->_report_last)) {
+            dev->_wakeup_requested = tud_remote_wakeup();
+        }
+        return false;
+    }
+    dev->_wakeup_requested = false;
+
+    if (!tud_ready()) {
+        return false;
+    }
+
+    const uint32_t queued = dev->_reports_queued;
+    publish_xinput_n_report(instance, report);
+
+    // Start the transfer now if the endpoint is idle, otherwise the IN
+    // completion will pick the report up. Counted here rather than in
+    // flush_xinput_n_report() so SOF retries do not count the same report.
+    if (!flush_xinput_n_report(instance) && dev->_reports_queued != queued &&
+        (__atomic_load_n(&dev->_report_middle, __ATOMIC_ACQUIRE) & XINPUT_REPORT_PENDING)) {
+        XINPUT_STATS(__atomic_fetch_add(&dev->_stats.rejected_busy, 1, __ATOMIC_RELAXED));
+    }
+    return true;
+}
+
+bool publish_xinput_n_report(uint8_t instance, const xinput_report_t *report) {
+    // Only producer-owned state and the middle index are touched here, so this
+    // is safe to call from another core than the one running the USB stack
+    Adafruit_USBD_XInput *dev = xinput_dev(instance);
+    if (!dev) {
+        return false;
+    }
+
+    dev->trackSuspend(tud_suspended());
+
+    const uint32_t now_ms = millis();
+    const bool changed = !xinput_report_equal(report, &dev->_report_last);
+    if (changed) {
+        dev->_last_change_ms = now_ms;
+    }
+
+    if (dev->_change_detection && !changed &&
+        (dev->_keepalive_ms == 0 || now_ms - dev->_last_queued_ms < dev->_keepalive_ms)) {
+        dev->_reports_suppressed++;
+        XINPUT_TRACE(XINPUT_TRACE_SEND, instance, 1);
+        return true;
+    }
+
+    XINPUT_TRACE(XINPUT_TRACE_SEND, instance, 0);
+    memcpy(&dev->_report_last, report, sizeof(xinput_report_t));
+    dev->_last_queued_ms = now_ms;
+    dev->_reports_queued++;
+
+    // Fill the back slot, then publish it as the newest pending report. Whatever
+    // was pending before is superseded and its slot becomes the new back slot.
+    memcpy(&dev->_reports[dev->_report_back], report, sizeof(xinput_report_t));
+    dev->_report_back = __atomic_exchange_n(
+                            &dev->_report_middle,
+                            (uint8_t)(dev->_report_back | XINPUT_REPORT_PENDING),
+                            __ATOMIC_ACQ_REL
+                        ) &
+                        XINPUT_REPORT_INDEX_MASK;
+
+    return true;
+}
+
+bool flush_xinput_n_report(uint8_t instance) {
+    Adafruit_USBD_XInput *dev = xinput_dev(instance);
+    if (!dev || !dev->_endpoint_in ||
+        !(__atomic_load_n(&dev->_report_middle, __ATOMIC_ACQUIRE) & XINPUT_REPORT_PENDING)) {
+        return false;
+    }
+
+    // Claim fails while a transfer is in flight or another context is
+    // submitting, in both cases the pending report is picked up by whoever
+    // holds the endpoint
+    if (!usbd_edpt_claim(TUD_OPT_RHPORT, dev->_endpoint_in)) {
+        return false;
+    }
+
+    // Whoever held the endpoint before may have sent the report checked above,
+    // the middle slot then holds an older one that must not go out again
+    if (!(__atomic_load_n(&dev->_report_middle, __ATOMIC_ACQUIRE) & XINPUT_REPORT_PENDING)) {
+        usbd_edpt_release(TUD_OPT_RHPORT, dev->_endpoint_in);
+        return false;
+    }
+
+    const uint8_t previous = dev->_report_front;
+    dev->_report_front =
+        __atomic_exchange_n(&dev->_report_middle, previous, __ATOMIC_ACQ_REL) &
+        XINPUT_REPORT_INDEX_MASK;
+
+    const bool sent = usbd_edpt_xfer(
+        TUD_OPT_RHPORT,
+        dev->_endpoint_in,
+        (uint8_t *)&dev->_reports[dev->_report_front],
+        sizeof(xinput_report_t)
+    );
+
+    // Put the report back as pending unless the producer has published a newer
+    // one in the meantime
+    uint8_t expected = previous;
+    if (!sent && __atomic_compare_exchange_n(
+                     &dev->_report_middle,
+                     &expected,
+                     (uint8_t)(dev->_report_front | XINPUT_REPORT_PENDING),
+                     false,
+                     __ATOMIC_ACQ_REL,
+                     __ATOMIC_ACQUIRE
+                 )) {
+        dev->_report_front = previous;
+    }
+
+    // Still under the claim, which keeps submitting contexts apart
+    if (sent) {
+        dev->_report_front_sent = true;
+#if CFG_XINPUT_STATS
+        dev->_stats.submitted++;
+        dev->_in_submit_us = micros();
+#endif
+    }
+    usbd_edpt_release(TUD_OPT_RHPORT, dev->_endpoint_in);
+
+    if (sent) {
+        XINPUT_TRACE(XINPUT_TRACE_IN_ARMED, instance, 0);
     }
 
     return sent;
@@ -210,8 +769,50 @@ bool send_xinput_report(xinput_report_t *report) {
 
 static void xinput_init(void) {}
 
-static void xinput_reset(uint8_t rhport) {
+void xinput_reset(uint8_t rhport) {
     (void)rhport;
+
+    XINPUT_TRACE(XINPUT_TRACE_RESET, XINPUT_TRACE_ANY, 0);
+
+    // Endpoint addresses may change with the next configuration
+    memset(_xinput_ep_map, 0, sizeof(_xinput_ep_map));
+
+    for (uint8_t i = 0; i < _xinput_dev_count; i++) {
+        Adafruit_USBD_XInput *dev = _xinput_devs[i];
+        const bool was_open = dev->_endpoint_in || dev->_endpoint_out;
+        xinput_startup_mark(&dev->_startup.reset_us);
+
+        dev->_endpoint_in = 0;
+        dev->_endpoint_out = 0;
+        dev->_wakeup_requested = false;
+
+        // Drop OUT packets and host state of the previous session. The queue
+        // tail belongs to the reader, so it is only told up to where to drop.
+        // A rumble level that was on is reported as an update to 0 so the
+        // motors stop.
+        __atomic_store_n(&dev->_out_flush_head, dev->_out_head, __ATOMIC_RELAXED);
+        __atomic_store_n(
+            &dev->_out_flush_gen,
+            (uint8_t)(dev->_out_flush_gen + 1),
+            __ATOMIC_RELEASE
+        );
+        if (__atomic_exchange_n(&dev->_rumble, (uint16_t)0, __ATOMIC_ACQ_REL)) {
+            __atomic_store_n(&dev->_rumble_updated, true, __ATOMIC_RELEASE);
+            if (dev->_rumble_cb) {
+                dev->_rumble_cb(0, 0);
+            }
+        }
+        dev->_led_pattern = 0;
+
+        dev->recordBusEvents();
+        if (dev->_recorder) {
+            xinput_recorder_event(dev->_recorder, micros(), XINPUT_LOG_EVENT_RESET);
+        }
+
+        if (was_open && dev->_mount_cb) {
+            dev->_mount_cb(false);
+        }
+    }
 }
 
 uint16_t xinput_open(
@@ -225,6 +826,14 @@ uint16_t xinput_open(
         return false;
     }
 
+    Adafruit_USBD_XInput *dev = NULL;
+    for (uint8_t i = 0; i < _xinput_dev_count && !dev; i++) {
+        if (_xinput_devs[i]->_itfnum == itf_descriptor->bInterfaceNumber) {
+            dev = _xinput_devs[i];
+        }
+    }
+    TU_VERIFY(dev, 0);
+
     uint16_t driver_length = sizeof(tusb_desc_interface_t) +
                              (itf_descriptor->bNumEndpoints * sizeof(tusb_desc_endpoint_t)) + 16;
 
@@ -239,15 +848,59 @@ uint16_t xinput_open(
             TU_ASSERT(usbd_edpt_open(rhport, endpoint_descriptor));
 
             if (tu_edpt_dir(endpoint_descriptor->bEndpointAddress) == TUSB_DIR_IN)
-                _xinput_dev->_endpoint_in = endpoint_descriptor->bEndpointAddress;
+                dev->_endpoint_in = endpoint_descriptor->bEndpointAddress;
             else
-                _xinput_dev->_endpoint_out = endpoint_descriptor->bEndpointAddress;
+                dev->_endpoint_out = endpoint_descriptor->bEndpointAddress;
+
+            _xinput_ep_map[XINPUT_EP_MAP_INDEX(endpoint_descriptor->bEndpointAddress)] =
+                dev->_instance + 1;
 
             ++found_endpoints;
         }
 
         current_descriptor = tu_desc_next(current_descriptor);
     }
+
+#if TUSB_VERSION_MINOR >= 15
+    // SOF is opt-in since TinyUSB 0.15. Keep it on while the interface is open:
+    // besides the latch callback it is what picks up reports published from
+    // another core while the IN endpoint is idle.
+    usbd_sof_enable(rhport, true);
+#endif
+
+    dev->recordBusEvents();
+    if (dev->_recorder) {
+        xinput_recorder_event(dev->_recorder, micros(), XINPUT_LOG_EVENT_MOUNT);
+    }
+
+    // Start receiving OUT reports right away
+    if (dev->_endpoint_out) {
+        usbd_edpt_xfer(rhport, dev->_endpoint_out, dev->_out_buffers[dev->_out_rx], EPSIZE);
+    }
+
+    // Resync the host: send the newest pending report, or else the last one
+    // submitted before the reset, which is still in the front slot. Before
+    // the application published anything there is nothing to resync with.
+    if (dev->_endpoint_in && !flush_xinput_n_report(dev->_instance) &&
+        dev->_report_front_sent &&
+        usbd_edpt_xfer(
+            rhport,
+            dev->_endpoint_in,
+            (uint8_t *)&dev->_reports[dev->_report_front],
+            sizeof(xinput_report_t)
+        )) {
+#if CFG_XINPUT_STATS
+        dev->_stats.submitted++;
+        dev->_in_submit_us = micros();
+#endif
+        XINPUT_TRACE(XINPUT_TRACE_IN_ARMED, dev->_instance, 0);
+    }
+
+    xinput_startup_mark(&dev->_startup.mounted_us);
+    if (dev->_mount_cb) {
+        dev->_mount_cb(true);
+    }
+
     return driver_length;
 }
 
@@ -263,6 +916,16 @@ bool xinput_control_xfer_callback(
     return true;
 }
 
+#if CFG_XINPUT_STATS
+static inline uint8_t xinput_stats_bucket(uint32_t duration_us) {
+    if (duration_us < 128) {
+        return 0;
+    }
+    const uint8_t bucket = 31 - __builtin_clz(duration_us) - 6;
+    return bucket < XINPUT_STATS_BUCKETS ? bucket : XINPUT_STATS_BUCKETS - 1;
+}
+#endif
+
 bool xinput_xfer_callback(
     uint8_t rhport,
     uint8_t ep_addr,
@@ -270,20 +933,168 @@ bool xinput_xfer_callback(
     uint32_t xferred_bytes
 ) {
     (void)rhport;
-    (void)result;
-    (void)xferred_bytes;
 
-    if (ep_addr == _xinput_dev->_endpoint_out)
-        usbd_edpt_xfer(
-            TUD_OPT_RHPORT,
-            _xinput_dev->_endpoint_out,
-            _xinput_dev->_xinput_out_buffer,
-            EPSIZE
-        );
+    Adafruit_USBD_XInput *dev = xinput_dev_for_ep(ep_addr);
+    TU_VERIFY(dev);
+
+    if (ep_addr == dev->_endpoint_out) {
+        const uint8_t received = dev->_out_rx;
+        const uint8_t *packet = dev->_out_buffers[received];
+
+        if (result == XFER_RESULT_SUCCESS) {
+            dev->_out_length[received] = (uint8_t)xferred_bytes;
+
+            // Queue the packet if enabled and there is room by swapping it into
+            // the ring, otherwise swap it with the spare buffer
+            const uint8_t head = dev->_out_head;
+            const uint8_t tail = __atomic_load_n(&dev->_out_tail, __ATOMIC_ACQUIRE);
+            const bool queue = dev->_out_queue_enabled;
+            if (queue && (uint8_t)(head - tail) < CFG_XINPUT_OUT_QUEUE) {
+                const uint8_t slot = head % CFG_XINPUT_OUT_QUEUE;
+                dev->_out_rx = dev->_out_ring[slot];
+                dev->_out_ring[slot] = received;
+                __atomic_store_n(&dev->_out_head, (uint8_t)(head + 1), __ATOMIC_RELEASE);
+            } else {
+                if (queue) {
+                    dev->_out_dropped++;
+                    XINPUT_STATS(dev->_stats.out_overruns++);
+                }
+                dev->_out_rx = dev->_out_spare;
+                dev->_out_spare = received;
+            }
+        }
+
+        // Re-arm first so the host is not NAKed while the completed packet is
+        // handled
+        usbd_edpt_xfer(TUD_OPT_RHPORT, dev->_endpoint_out, dev->_out_buffers[dev->_out_rx], EPSIZE);
+
+        if (result == XFER_RESULT_SUCCESS) {
+            XINPUT_STATS(dev->_stats.out_received++);
+            XINPUT_TRACE(XINPUT_TRACE_OUT_RECEIVED, dev->_instance, (uint16_t)xferred_bytes);
+            dev->recordBusEvents();
+            if (dev->_recorder) {
+                xinput_recorder_out(dev->_recorder, micros(), packet, (uint8_t)xferred_bytes);
+            }
+            dev->handleOutReport(packet, (uint16_t)xferred_bytes);
+        }
+    } else if (ep_addr == dev->_endpoint_in) {
+        XINPUT_TRACE(XINPUT_TRACE_IN_COMPLETE, dev->_instance, (uint16_t)result);
+        if (result != XFER_RESULT_SUCCESS) {
+            // The host did not get the report, so nothing to count or signal.
+            // The endpoint is free again for whatever is pending.
+            flush_xinput_n_report(dev->_instance);
+            return true;
+        }
+
+        const uint32_t now_us = micros();
+
+        // The front slot holds what the host just read until the flush below
+        dev->recordBusEvents();
+        if (dev->_recorder) {
+            xinput_recorder_report(dev->_recorder, now_us, &dev->_reports[dev->_report_front]);
+        }
+
+#if CFG_XINPUT_STATS
+        dev->_stats.completed++;
+        dev->_stats.latency_hist[xinput_stats_bucket(now_us - dev->_in_submit_us)]++;
+        if (dev->_stats.completed > 1) {
+            const int32_t interval_us = (int32_t)(now_us - dev->_in_complete_us);
+            const int32_t jitter_us = interval_us - dev->_interval_ms * XINPUT_FRAME_US;
+            dev->_stats.jitter_hist[xinput_stats_bucket(jitter_us < 0 ? -jitter_us : jitter_us)]++;
+        }
+        dev->_in_complete_us = now_us;
+#endif
+
+        if (dev->_latch_cb) {
+            // Track where in the frame the host polls, and in which frame of
+            // the polling interval. Both times are taken when the task
+            // handles the events, see framePhase().
+            const int32_t phase = (int32_t)(now_us - dev->_sof_time_us);
+            if (phase >= 0 && phase < XINPUT_FRAME_US) {
+                dev->_frame_phase_us += (phase - dev->_frame_phase_us) / 8;
+            }
+            dev->_poll_slot = dev->_sof_count % dev->_interval_ms;
+        }
+
+        flush_xinput_n_report(dev->_instance);
+
+        // Wake whoever waits for the slot before running the callback
+        __atomic_store_n(&dev->_report_sent, true, __ATOMIC_RELEASE);
+        xinput_startup_mark(&dev->_startup.first_report_us);
+#if defined(ARDUINO_ARCH_RP2040)
+        __sev();
+#elif defined(ARDUINO_ARCH_ESP32)
+        TaskHandle_t waiting_task =
+            (TaskHandle_t)__atomic_exchange_n(&dev->_waiting_task, NULL, __ATOMIC_ACQ_REL);
+        if (waiting_task) {
+            xTaskNotifyGive(waiting_task);
+        }
+#endif
+
+        if (dev->_report_sent_cb) {
+            dev->_report_sent_cb();
+        }
+    }
 
     return true;
 }
 
+#ifdef ARDUINO_ARCH_RP2040
+static int64_t xinput_latch_alarm(alarm_id_t id, void *user_data) {
+    (void)id;
+
+    xinput_latch_cb_t callback = (xinput_latch_cb_t)user_data;
+    callback();
+    return 0;
+}
+#endif
+
+void xinput_sof(uint8_t rhport, uint32_t frame_count) {
+    (void)rhport;
+    (void)frame_count;
+
+    XINPUT_TRACE(XINPUT_TRACE_SOF, XINPUT_TRACE_ANY, (uint16_t)frame_count);
+    const uint32_t now_us = micros();
+
+    for (uint8_t i = 0; i < _xinput_dev_count; i++) {
+        Adafruit_USBD_XInput *dev = _xinput_devs[i];
+        dev->recordBusEvents();
+
+        // Pick up reports published from another core while the endpoint
+        // was idle
+        flush_xinput_n_report(i);
+
+        if (!dev->_latch_cb) {
+            continue;
+        }
+
+        dev->_sof_time_us = now_us;
+        dev->_sof_count++;
+
+        // Latch time relative to the SOF of the frame the host polls in. If the
+        // lead reaches back past that SOF, latch in an earlier frame instead.
+        int32_t offset_us = (int32_t)dev->_frame_phase_us - dev->_latch_lead_us;
+        uint32_t frames_early = 0;
+        while (offset_us < 0) {
+            offset_us += XINPUT_FRAME_US;
+            frames_early++;
+        }
+
+        if ((dev->_sof_count + frames_early) % dev->_interval_ms != dev->_poll_slot) {
+            continue;
+        }
+
+#ifdef ARDUINO_ARCH_RP2040
+        if (offset_us > 0 &&
+            add_alarm_in_us(offset_us, xinput_latch_alarm, (void *)dev->_latch_cb, true) > 0) {
+            continue;
+        }
+#endif
+
+        dev->_latch_cb();
+    }
+}
+
 //------------- TinyUSB callbacks -------------//
 extern "C" {
 
@@ -296,7 +1107,7 @@ const usbd_class_driver_t xinput_driver = {
     .open = xinput_open,
     .control_xfer_cb = xinput_control_xfer_callback,
     .xfer_cb = xinput_xfer_callback,
-    .sof = NULL
+    .sof = xinput_sof
 };
 
 const usbd_class_driver_t *usbd_app_driver_get_cb(uint8_t *driver_count) {
@@ -305,7 +1116,7 @@ const usbd_class_driver_t *usbd_app_driver_get_cb(uint8_t *driver_count) {
 }
 
 const uint8_t *tud_descriptor_bos_cb(void) {
-    return desc_bos;
+    return desc_bos.data;
 }
 
 bool tud_vendor_control_xfer_cb(
@@ -313,7 +1124,7 @@ bool tud_vendor_control_xfer_cb(
     uint8_t stage,
     const tusb_control_request_t *request
 ) {
-    if (!_xinput_dev) {
+    if (!_xinput_dev_count) {
         return false;
     }
 
@@ -322,31 +1133,28 @@ bool tud_vendor_control_xfer_cb(
         return true;
     }
 
-    switch (request->bmRequestType_bit.type) {
-        case TUSB_REQ_TYPE_VENDOR:
-            switch (request->bRequest) {
-                case VENDOR_REQUEST_MICROSOFT:
-                    if (request->wIndex == 7) {
-                        // Get Microsoft OS 2.0 compatible descriptor
-                        uint16_t total_len;
-                        memcpy(&total_len, desc_ms_os_20 + 8, 2);
-
-                        return tud_control_xfer(rhport, request, (void *)desc_ms_os_20, total_len);
-                    } else {
-                        return false;
-                    }
+    const bool answered = xinput_control_respond(rhport, request);
+    XINPUT_TRACE(
+        XINPUT_TRACE_CONTROL,
+        XINPUT_TRACE_ANY,
+        (uint16_t)(request->bRequest | (answered ? 0 : 0x100))
+    );
 
-                default:
-                    break;
+#if CFG_XINPUT_STATS
+    // Interface requests are counted on the instance wIndex addresses, device
+    // requests on instance 0
+    Adafruit_USBD_XInput *dev = _xinput_devs[0];
+    if (request->bmRequestType_bit.recipient == TUSB_REQ_RCPT_INTERFACE) {
+        for (uint8_t i = 0; i < _xinput_dev_count; i++) {
+            if (_xinput_devs[i]->_itfnum == TU_U16_LOW(request->wIndex)) {
+                dev = _xinput_devs[i];
             }
-            break;
-
-        default:
-            // stall unknown request
-            return false;
+        }
     }
+    answered ? dev->_stats.control_answered++ : dev->_stats.control_stalled++;
+#endif
 
-    return true;
+    return answered;
 }
 
 } // extern "C"
@@ -0,0 +1,210 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "xinput_adc.hpp"
+
+#include <string.h>
+
+#ifdef ARDUINO_ARCH_RP2040
+#include <hardware/adc.h>
+#include <hardware/clocks.h>
+#include <hardware/dma.h>
+#endif
+
+// 12-bit samples are widened to 16 bits before filtering
+#define XINPUT_ADC_SAMPLE_SHIFT 4
+
+bool xinput_adc_filter_init(xinput_adc_filter_t *filter, uint8_t channels, uint8_t shift) {
+    memset(filter, 0, sizeof(xinput_adc_filter_t));
+    if (channels == 0 || channels > XINPUT_ADC_MAX_CHANNELS) {
+        // Left with no channels, so process() ignores every sample
+        return false;
+    }
+    filter->channels = channels;
+    // acc holds a 16-bit value << shift
+    filter->shift = shift < 16 ? shift : 16;
+    return true;
+}
+
+void xinput_adc_filter_process(
+    xinput_adc_filter_t *filter,
+    const uint16_t *samples,
+    uint32_t count,
+    uint8_t first
+) {
+    if (first >= filter->channels) {
+        return;
+    }
+
+    const uint8_t shift = filter->shift;
+    uint8_t channel = first;
+
+    for (uint32_t i = 0; i < count; i++) {
+        const uint32_t sample = (uint32_t)(samples[i] & 0x0FFF) << XINPUT_ADC_SAMPLE_SHIFT;
+        uint32_t *acc = &filter->acc[channel];
+        if (filter->primed & (1 << channel)) {
+            *acc += sample - (*acc >> shift);
+        } else {
+            // Start from the first sample rather than ramping up from 0
+            *acc = sample << shift;
+            filter->primed |= (uint8_t)(1 << channel);
+        }
+
+        if (++channel == filter->channels) {
+            channel = 0;
+        }
+    }
+}
+
+#ifdef ARDUINO_ARCH_RP2040
+bool xinput_adc_start(
+    xinput_adc_t *adc,
+    uint8_t channel_mask,
+    uint32_t sample_rate,
+    uint8_t shift
+) {
+    channel_mask &= (1 << XINPUT_ADC_MAX_CHANNELS) - 1;
+    if (!channel_mask || !sample_rate) {
+        return false;
+    }
+
+    memset(adc, 0, sizeof(xinput_adc_t));
+    adc->data_channel = -1;
+    adc->control_channel = -1;
+    xinput_adc_filter_init(&adc->filter, __builtin_popcount(channel_mask), shift);
+    adc->ring_start = adc->ring;
+
+    adc->data_channel = dma_claim_unused_channel(false);
+    adc->control_channel = dma_claim_unused_channel(false);
+    if (adc->data_channel < 0 || adc->control_channel < 0) {
+        xinput_adc_stop(adc);
+        return false;
+    }
+
+    adc_init();
+    for (uint8_t input = 0; input < XINPUT_ADC_MAX_CHANNELS; input++) {
+        if (channel_mask & (1 << input)) {
+            adc_gpio_init(26 + input);
+        }
+    }
+    adc_select_input(__builtin_ctz(channel_mask));
+    adc_set_round_robin(channel_mask);
+    adc_fifo_setup(true, true, 1, false, false);
+    // A conversion takes 1 + div ADC clock cycles, 96 at minimum
+    adc_set_clkdiv((float)clock_get_hz(clk_adc) / sample_rate - 1);
+
+    // The data channel fills the ring from the ADC FIFO, then chains to the
+    // control channel which writes the ring address back into the data
+    // channel's write address trigger, restarting it
+    dma_channel_config data = dma_channel_get_default_config(adc->data_channel);
+    channel_config_set_transfer_data_size(&data, DMA_SIZE_16);
+    channel_config_set_read_increment(&data, false);
+    channel_config_set_write_increment(&data, true);
+    channel_config_set_dreq(&data, DREQ_ADC);
+    channel_config_set_chain_to(&data, adc->control_channel);
+    dma_channel_configure(
+        adc->data_channel,
+        &data,
+        adc->ring,
+        &adc_hw->fifo,
+        XINPUT_ADC_RING_SIZE,
+        false
+    );
+
+    dma_channel_config control = dma_channel_get_default_config(adc->control_channel);
+    channel_config_set_transfer_data_size(&control, DMA_SIZE_32);
+    channel_config_set_read_increment(&control, false);
+    channel_config_set_write_increment(&control, false);
+    dma_channel_configure(
+        adc->control_channel,
+        &control,
+        &dma_hw->ch[adc->data_channel].al2_write_addr_trig,
+        &adc->ring_start,
+        1,
+        false
+    );
+
+    dma_channel_start(adc->data_channel);
+    adc_run(true);
+    return true;
+}
+
+void xinput_adc_stop(xinput_adc_t *adc) {
+    // Never started, e.g. zero-initialized, or already stopped: channel 0
+    // may belong to someone else
+    if (!adc->ring_start) {
+        return;
+    }
+
+    if (adc->data_channel >= 0 && adc->control_channel >= 0) {
+        adc_run(false);
+        adc_fifo_drain();
+    }
+
+    if (adc->control_channel >= 0) {
+        dma_channel_abort(adc->control_channel);
+        dma_channel_unclaim(adc->control_channel);
+    }
+    if (adc->data_channel >= 0) {
+        // the control channel is stopped, so nothing restarts the data channel
+        dma_channel_abort(adc->data_channel);
+        dma_channel_unclaim(adc->data_channel);
+    }
+
+    adc->data_channel = -1;
+    adc->control_channel = -1;
+    adc->ring_start = NULL;
+}
+
+void xinput_adc_poll(xinput_adc_t *adc) {
+    if (!adc->ring_start) {
+        return;
+    }
+
+    const uintptr_t write_addr = dma_hw->ch[adc->data_channel].write_addr;
+    // Right at the end of the ring until the control channel restarts it
+    const uint32_t write_pos =
+        ((write_addr - (uintptr_t)adc->ring) / sizeof(uint16_t)) % XINPUT_ADC_RING_SIZE;
+    const uint8_t channels = adc->filter.channels;
+    uint32_t read_pos = adc->read_pos;
+
+    if (write_pos < read_pos) {
+        xinput_adc_filter_process(
+            &adc->filter,
+            &adc->ring[read_pos],
+            XINPUT_ADC_RING_SIZE - read_pos,
+            read_pos % channels
+        );
+        read_pos = 0;
+    }
+
+    xinput_adc_filter_process(
+        &adc->filter,
+        &adc->ring[read_pos],
+        write_pos - read_pos,
+        read_pos % channels
+    );
+    adc->read_pos = write_pos;
+}
+#endif
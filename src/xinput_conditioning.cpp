@@ -0,0 +1,172 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "xinput_conditioning.hpp"
+
+#define Q15_MAX 32767
+
+static inline int32_t xinput_clamp(int32_t value, int32_t low, int32_t high) {
+    return value < low ? low : (value > high ? high : value);
+}
+
+static void xinput_axis_init(
+    xinput_axis_t *axis,
+    int32_t center,
+    int32_t neg,
+    int32_t pos,
+    bool invert
+) {
+    axis->center = center;
+    axis->invert = invert;
+    // inverting swaps which side of center maps to positive output
+    axis->neg_span = invert ? pos : neg;
+    axis->pos_span = invert ? neg : pos;
+    axis->neg_scale = axis->neg_span > 0 ? ((int32_t)Q15_MAX << 16) / axis->neg_span : 0;
+    axis->pos_scale = axis->pos_span > 0 ? ((int32_t)Q15_MAX << 16) / axis->pos_span : 0;
+}
+
+// Raw counts to a signed Q15 value. The offset is clamped to the calibrated
+// span first, which also keeps the Q16 product within 32 bits.
+static inline int32_t xinput_axis_process(const xinput_axis_t *axis, uint16_t raw) {
+    int32_t value = (int32_t)raw - axis->center;
+    value = axis->invert ? -value : value;
+    value = xinput_clamp(value, -axis->neg_span, axis->pos_span);
+    return (value * (value < 0 ? axis->neg_scale : axis->pos_scale)) >> 16;
+}
+
+static void xinput_response_init(
+    xinput_response_t *response,
+    uint16_t deadzone,
+    uint16_t anti_deadzone,
+    const xinput_curve_t *curve
+) {
+    // keep the rescale factor below 2.0 so magnitude * rescale fits in 32 bits
+    response->deadzone = xinput_clamp(deadzone, 0, Q15_MAX / 2);
+    response->anti_deadzone = xinput_clamp(anti_deadzone, 0, Q15_MAX / 2);
+    response->rescale =
+        ((Q15_MAX - response->anti_deadzone) << 15) / (Q15_MAX - response->deadzone);
+    response->curve = curve;
+}
+
+// Q15 magnitude through deadzone, anti-deadzone and curve
+static inline int32_t xinput_response_process(
+    const xinput_response_t *response,
+    int32_t magnitude
+) {
+    if (magnitude <= response->deadzone) {
+        return 0;
+    }
+
+    magnitude = response->anti_deadzone +
+                (((magnitude - response->deadzone) * response->rescale) >> 15);
+    magnitude = xinput_clamp(magnitude, 0, Q15_MAX);
+
+    const xinput_curve_t *curve = response->curve;
+    if (curve) {
+        const int32_t index = magnitude >> XINPUT_CURVE_SHIFT;
+        const int32_t frac = magnitude & ((1 << XINPUT_CURVE_SHIFT) - 1);
+        const int32_t low = curve->points[index];
+        // index is at most XINPUT_CURVE_SEGMENTS - 1 since magnitude < 32768
+        const int32_t high = curve->points[index + 1];
+        magnitude = low + (((high - low) * frac) >> XINPUT_CURVE_SHIFT);
+    }
+
+    return magnitude;
+}
+
+// Bit-by-bit integer square root, 16 iterations for any 32-bit input
+static inline uint32_t xinput_isqrt(uint32_t value) {
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+    for (uint8_t i = 0; i < 16; i++) {
+        const uint32_t trial = root + bit;
+        const bool fits = value >= trial;
+        value -= fits ? trial : 0;
+        root = (root >> 1) + (fits ? bit : 0);
+        bit >>= 2;
+    }
+    return root;
+}
+
+void xinput_stick_init(xinput_stick_t *stick, const xinput_stick_config_t *config) {
+    const xinput_axis_cal_t *x = &config->x;
+    const xinput_axis_cal_t *y = &config->y;
+
+    xinput_axis_init(&stick->x, x->center, x->center - x->min, x->max - x->center, x->invert);
+    xinput_axis_init(&stick->y, y->center, y->center - y->min, y->max - y->center, y->invert);
+    xinput_response_init(&stick->response, config->deadzone, config->anti_deadzone, config->curve);
+    stick->radial = config->radial;
+}
+
+void xinput_stick_process(
+    const xinput_stick_t *stick,
+    uint16_t raw_x,
+    uint16_t raw_y,
+    int16_t *x,
+    int16_t *y
+) {
+    const int32_t in_x = xinput_axis_process(&stick->x, raw_x);
+    const int32_t in_y = xinput_axis_process(&stick->y, raw_y);
+
+    if (stick->radial) {
+        // Scale the vector so its magnitude follows the response, magnitudes
+        // past the unit circle (the corners of a square gate) saturate
+        const uint32_t squared = (uint32_t)(in_x * in_x) + (uint32_t)(in_y * in_y);
+        const int32_t magnitude = (int32_t)xinput_isqrt(squared);
+        const int32_t clamped = magnitude > Q15_MAX ? Q15_MAX : magnitude;
+        const int32_t response = xinput_response_process(&stick->response, clamped);
+
+        if (response == 0) {
+            *x = 0;
+            *y = 0;
+            return;
+        }
+
+        *x = (int16_t)((in_x * response) / magnitude);
+        *y = (int16_t)((in_y * response) / magnitude);
+    } else {
+        const int32_t out_x = xinput_response_process(&stick->response, in_x < 0 ? -in_x : in_x);
+        const int32_t out_y = xinput_response_process(&stick->response, in_y < 0 ? -in_y : in_y);
+        *x = (int16_t)(in_x < 0 ? -out_x : out_x);
+        *y = (int16_t)(in_y < 0 ? -out_y : out_y);
+    }
+}
+
+void xinput_trigger_init(xinput_trigger_t *trigger, const xinput_trigger_config_t *config) {
+    // A trigger is the positive half of an axis centered on its released value
+    const bool invert = config->max < config->min;
+    const int32_t span = invert ? config->min - config->max : config->max - config->min;
+    xinput_axis_init(&trigger->axis, config->min, invert ? span : 0, invert ? 0 : span, invert);
+    xinput_response_init(
+        &trigger->response,
+        config->deadzone,
+        config->anti_deadzone,
+        config->curve
+    );
+}
+
+uint8_t xinput_trigger_process(const xinput_trigger_t *trigger, uint16_t raw) {
+    const int32_t value = xinput_axis_process(&trigger->axis, raw);
+    return (uint8_t)(xinput_response_process(&trigger->response, value) >> 7);
+}
@@ -0,0 +1,168 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "xinput_hid_adapter.hpp"
+#include "xinput_report.hpp"
+
+#include <string.h>
+
+// D-pad bits for hat values 0-7, clockwise from up
+static const uint8_t xinput_hid_hat[8] = {
+    XINPUT_BUTTON_DPAD_UP,
+    XINPUT_BUTTON_DPAD_UP | XINPUT_BUTTON_DPAD_RIGHT,
+    XINPUT_BUTTON_DPAD_RIGHT,
+    XINPUT_BUTTON_DPAD_DOWN | XINPUT_BUTTON_DPAD_RIGHT,
+    XINPUT_BUTTON_DPAD_DOWN,
+    XINPUT_BUTTON_DPAD_DOWN | XINPUT_BUTTON_DPAD_LEFT,
+    XINPUT_BUTTON_DPAD_LEFT,
+    XINPUT_BUTTON_DPAD_UP | XINPUT_BUTTON_DPAD_LEFT,
+};
+
+static inline uint8_t xinput_hid_axis_size(const xinput_hid_axis_t *axis) {
+    return (axis->flags & XINPUT_HID_AXIS_TYPE_MASK) >= XINPUT_HID_AXIS_U16 ? 2 : 1;
+}
+
+// Axis value as a signed 16-bit quantity, full scale on both sides
+static int32_t xinput_hid_axis_read(const xinput_hid_axis_t *axis, const uint8_t *data) {
+    const uint8_t *src = data + axis->offset;
+    int32_t value;
+
+    switch (axis->flags & XINPUT_HID_AXIS_TYPE_MASK) {
+        case XINPUT_HID_AXIS_U8:
+            value = ((int32_t)src[0] - 128) * 256;
+            break;
+        case XINPUT_HID_AXIS_S8:
+            value = (int32_t)(int8_t)src[0] * 256;
+            break;
+        case XINPUT_HID_AXIS_U16:
+            value = (int32_t)xinput_get_le16(src) - 32768;
+            break;
+        default:
+            value = (int16_t)xinput_get_le16(src);
+            break;
+    }
+
+    // -32768 inverts to 32768, clamp it back into range
+    return axis->flags & XINPUT_HID_AXIS_INVERT ? (value == -32768 ? 32767 : -value) : value;
+}
+
+static inline int16_t xinput_hid_stick(const xinput_hid_axis_t *axis, const uint8_t *data) {
+    return axis->offset == XINPUT_HID_NONE ? 0 : (int16_t)xinput_hid_axis_read(axis, data);
+}
+
+// Triggers rest at the low end of their range
+static inline uint8_t xinput_hid_trigger(const xinput_hid_axis_t *axis, const uint8_t *data) {
+    if (axis->offset == XINPUT_HID_NONE) {
+        return 0;
+    }
+    return (uint8_t)((xinput_hid_axis_read(axis, data) + 32768) >> 8);
+}
+
+// Bytes of the report the map reads from, for the length check
+static uint16_t xinput_hid_map_length(const xinput_hid_map_t *map) {
+    uint16_t length = 0;
+
+    for (uint8_t i = 0; i < XINPUT_BUTTON_COUNT; i++) {
+        if (map->buttons[i].offset != XINPUT_HID_NONE && map->buttons[i].offset >= length) {
+            length = map->buttons[i].offset + 1;
+        }
+    }
+
+    if (map->hat_offset != XINPUT_HID_NONE && map->hat_offset >= length) {
+        length = map->hat_offset + 1;
+    }
+
+    const xinput_hid_axis_t *axes[] = { &map->lx, &map->ly, &map->rx,
+                                        &map->ry, &map->lt, &map->rt };
+    for (const xinput_hid_axis_t *axis : axes) {
+        const uint16_t end = axis->offset + xinput_hid_axis_size(axis);
+        if (axis->offset != XINPUT_HID_NONE && end > length) {
+            length = end;
+        }
+    }
+
+    return length;
+}
+
+bool xinput_hid_translate(
+    const xinput_hid_map_t *map,
+    const uint8_t *hid,
+    uint16_t len,
+    xinput_report_t *report
+) {
+    if (map->report_id) {
+        TU_VERIFY(len > 0 && hid[0] == map->report_id);
+        hid++;
+        len--;
+    }
+    TU_VERIFY(len >= xinput_hid_map_length(map));
+
+    uint16_t buttons = 0;
+    for (uint8_t i = 0; i < XINPUT_BUTTON_COUNT; i++) {
+        const xinput_hid_button_t *button = &map->buttons[i];
+        if (button->offset != XINPUT_HID_NONE && (hid[button->offset] & button->mask)) {
+            buttons |= (uint16_t)(1u << i);
+        }
+    }
+
+    if (map->hat_offset != XINPUT_HID_NONE) {
+        const uint8_t hat = hid[map->hat_offset] & 0x0F;
+        if (hat < 8) {
+            buttons |= xinput_hid_hat[hat];
+        }
+    }
+
+    memset(report, 0, sizeof(xinput_report_t));
+    report->report_size = sizeof(xinput_report_t);
+    xinput_report_set_buttons(report, buttons);
+    xinput_report_set_triggers(
+        report,
+        xinput_hid_trigger(&map->lt, hid),
+        xinput_hid_trigger(&map->rt, hid)
+    );
+    xinput_report_set_sticks(
+        report,
+        xinput_hid_stick(&map->lx, hid),
+        xinput_hid_stick(&map->ly, hid),
+        xinput_hid_stick(&map->rx, hid),
+        xinput_hid_stick(&map->ry, hid)
+    );
+
+    return true;
+}
+
+bool xinput_hid_forward(
+    Adafruit_USBD_XInput *xinput,
+    const xinput_hid_map_t *map,
+    const uint8_t *hid,
+    uint16_t len
+) {
+    xinput_report_t report;
+    TU_VERIFY(xinput_hid_translate(map, hid, len, &report));
+
+    // The host callback may run on another core than the device stack, which
+    // picks the report up on IN completion or SOF
+    return xinput->publishReport(&report);
+}
@@ -0,0 +1,198 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "xinput_recorder.hpp"
+
+#include <Arduino.h>
+#include <string.h>
+
+static inline uint8_t xinput_log_tag(uint8_t type, uint8_t arg) {
+    return (uint8_t)((type << XINPUT_LOG_TYPE_SHIFT) | (arg & XINPUT_LOG_ARG_MASK));
+}
+
+static inline uint8_t xinput_log_put_varint(uint8_t *dst, uint32_t value) {
+    uint8_t len = 0;
+    while (value >= 0x80) {
+        dst[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    dst[len++] = (uint8_t)value;
+    return len;
+}
+
+// Appends a record if it fits. Interrupts are masked so records from the USB
+// interrupt and the main loop do not interleave; all recording must happen on
+// one core.
+static bool xinput_log_append(
+    xinput_recorder_t *recorder,
+    uint32_t now_us,
+    uint8_t tag,
+    const uint8_t *payload,
+    uint8_t payload_len
+) {
+    uint8_t header[6];
+    bool stored = false;
+
+    noInterrupts();
+
+    uint8_t len = 0;
+    header[len++] = tag;
+    len += xinput_log_put_varint(header + len, recorder->length ? now_us - recorder->last_us : 0);
+
+    if (recorder->length + len + payload_len <= recorder->capacity) {
+        uint8_t *dst = recorder->buffer + recorder->length;
+        memcpy(dst, header, len);
+        if (payload_len) {
+            memcpy(dst + len, payload, payload_len);
+        }
+        recorder->length += len + payload_len;
+        recorder->last_us = now_us;
+        stored = true;
+    } else {
+        recorder->dropped++;
+    }
+
+    interrupts();
+
+    return stored;
+}
+
+void xinput_recorder_init(xinput_recorder_t *recorder, uint8_t *buffer, uint32_t capacity) {
+    memset(recorder, 0, sizeof(xinput_recorder_t));
+    recorder->buffer = buffer;
+    recorder->capacity = capacity;
+}
+
+bool xinput_recorder_report(
+    xinput_recorder_t *recorder,
+    uint32_t now_us,
+    const xinput_report_t *report
+) {
+    const uint8_t *src = (const uint8_t *)report;
+    const uint8_t *last = (const uint8_t *)&recorder->last_report;
+    uint8_t payload[sizeof(xinput_report_t)];
+    uint8_t payload_len = 0;
+    uint8_t mask = 0;
+
+    for (uint8_t i = 0; i < XINPUT_LOG_REPORT_WORDS; i++) {
+        const uint8_t offset = i * sizeof(uint32_t);
+        if (memcmp(src + offset, last + offset, sizeof(uint32_t))) {
+            memcpy(payload + payload_len, src + offset, sizeof(uint32_t));
+            payload_len += sizeof(uint32_t);
+            mask |= (uint8_t)(1u << i);
+        }
+    }
+
+    const uint8_t tag = xinput_log_tag(XINPUT_LOG_REPORT, mask);
+    TU_VERIFY(xinput_log_append(recorder, now_us, tag, payload, payload_len));
+
+    // Only advance the delta base once the record is in the log
+    memcpy(&recorder->last_report, report, sizeof(xinput_report_t));
+    return true;
+}
+
+bool xinput_recorder_out(
+    xinput_recorder_t *recorder,
+    uint32_t now_us,
+    const uint8_t *data,
+    uint8_t length
+) {
+    uint8_t payload[1 + EPSIZE];
+
+    payload[0] = length < EPSIZE ? length : EPSIZE;
+    memcpy(payload + 1, data, payload[0]);
+
+    const uint8_t tag = xinput_log_tag(XINPUT_LOG_OUT, 0);
+    return xinput_log_append(recorder, now_us, tag, payload, payload[0] + 1);
+}
+
+bool xinput_recorder_event(xinput_recorder_t *recorder, uint32_t now_us, uint8_t event) {
+    return xinput_log_append(recorder, now_us, xinput_log_tag(XINPUT_LOG_EVENT, event), NULL, 0);
+}
+
+void xinput_log_reader_init(xinput_log_reader_t *reader, const uint8_t *buffer, uint32_t length) {
+    memset(reader, 0, sizeof(xinput_log_reader_t));
+    reader->buffer = buffer;
+    reader->length = length;
+}
+
+bool xinput_log_read(xinput_log_reader_t *reader, xinput_log_record_t *record) {
+    const uint8_t *buffer = reader->buffer;
+    uint32_t pos = reader->pos;
+
+    if (pos >= reader->length) {
+        return false;
+    }
+
+    const uint8_t tag = buffer[pos++];
+
+    uint32_t delta_us = 0;
+    for (uint8_t shift = 0;; shift += 7) {
+        TU_VERIFY(pos < reader->length && shift < 35);
+        const uint8_t byte = buffer[pos++];
+        delta_us |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+
+    memset(record, 0, sizeof(xinput_log_record_t));
+    record->type = tag >> XINPUT_LOG_TYPE_SHIFT;
+    record->time_us = reader->time_us + delta_us;
+
+    switch (record->type) {
+        case XINPUT_LOG_REPORT: {
+            const uint8_t mask = tag & XINPUT_LOG_ARG_MASK;
+            for (uint8_t i = 0; i < XINPUT_LOG_REPORT_WORDS; i++) {
+                if (mask & (1u << i)) {
+                    TU_VERIFY(pos + sizeof(uint32_t) <= reader->length);
+                    uint8_t *dst = (uint8_t *)&reader->report + i * sizeof(uint32_t);
+                    memcpy(dst, buffer + pos, sizeof(uint32_t));
+                    pos += sizeof(uint32_t);
+                }
+            }
+            record->report = &reader->report;
+            break;
+        }
+
+        case XINPUT_LOG_OUT:
+            TU_VERIFY(pos < reader->length);
+            record->length = buffer[pos++];
+            TU_VERIFY(record->length <= EPSIZE && pos + record->length <= reader->length);
+            record->data = buffer + pos;
+            pos += record->length;
+            break;
+
+        case XINPUT_LOG_EVENT:
+            record->event = tag & XINPUT_LOG_ARG_MASK;
+            break;
+
+        default:
+            return false;
+    }
+
+    reader->pos = pos;
+    reader->time_us = record->time_us;
+    return true;
+}
@@ -0,0 +1,66 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "xinput_scanner.hpp"
+
+#include <string.h>
+
+#ifdef ARDUINO_ARCH_RP2040
+#include <hardware/structs/sio.h>
+#endif
+
+void xinput_scanner_init(
+    xinput_scanner_t *scanner,
+    const xinput_button_remap_t *remap,
+    uint32_t invert
+) {
+    memset(scanner, 0, sizeof(xinput_scanner_t));
+    scanner->remap = remap;
+    scanner->invert = invert;
+}
+
+#ifdef ARDUINO_ARCH_RP2040
+uint16_t xinput_scanner_scan(xinput_scanner_t *scanner) {
+    return xinput_scanner_update(scanner, sio_hw->gpio_in);
+}
+
+static bool xinput_scanner_timer(repeating_timer_t *timer) {
+    xinput_scanner_scan((xinput_scanner_t *)timer->user_data);
+    return true;
+}
+
+bool xinput_scanner_start(xinput_scanner_t *scanner, uint32_t period_us) {
+    // A negative delay keeps the period fixed regardless of callback duration
+    return add_repeating_timer_us(
+        -(int64_t)period_us,
+        xinput_scanner_timer,
+        scanner,
+        &scanner->timer
+    );
+}
+
+void xinput_scanner_stop(xinput_scanner_t *scanner) {
+    cancel_repeating_timer(&scanner->timer);
+}
+#endif
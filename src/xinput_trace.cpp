@@ -0,0 +1,50 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "xinput_trace.hpp"
+
+#include <string.h>
+
+#if CFG_XINPUT_TRACE
+
+xinput_trace_entry_t _xinput_trace_ring[CFG_XINPUT_TRACE] = {};
+uint32_t _xinput_trace_count = 0;
+
+uint32_t xinput_trace_dump(xinput_trace_entry_t *dst, uint32_t max) {
+    const uint32_t count = xinput_trace_count();
+    const uint32_t available = count < CFG_XINPUT_TRACE ? count : CFG_XINPUT_TRACE;
+    const uint32_t copied = available < max ? available : max;
+
+    // The newest `copied` entries, in recording order
+    for (uint32_t i = 0; i < copied; i++) {
+        const uint32_t index = count - copied + i;
+        const xinput_trace_entry_t *entry = &_xinput_trace_ring[index & (CFG_XINPUT_TRACE - 1)];
+        memcpy(&dst[i], entry, sizeof(xinput_trace_entry_t));
+    }
+
+    return copied;
+}
+
+#endif
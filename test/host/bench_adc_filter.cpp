@@ -0,0 +1,52 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Cost of filtering ADC samples the way xinput_adc_poll() consumes the DMA
+// ring. At the RP2040's 500k conversions per second a 1 ms frame brings 500
+// samples, so the per-frame figure is the CPU time acquisition takes.
+
+#include "xinput_adc.hpp"
+#include "xinput_test.hpp"
+
+#define BENCH_ITERATIONS 2000000
+#define RING_SIZE 96
+#define FRAME_SAMPLES 500
+
+int main(void) {
+    static uint16_t ring[RING_SIZE];
+    for (uint32_t i = 0; i < RING_SIZE; i++) {
+        ring[i] = (uint16_t)(2048 + (i * 37) % 64);
+    }
+
+    xinput_adc_filter_t filter;
+    xinput_adc_filter_init(&filter, 4, 4);
+
+    const auto filter_ring = [&](uint32_t) {
+        xinput_adc_filter_process(&filter, ring, RING_SIZE, 0);
+        xinput_bench_keep(filter.acc);
+    };
+    const double ns = xinput_bench("filter 96 samples, 4 channels", BENCH_ITERATIONS, filter_ring);
+    printf("%-40s %10.1f ns/frame\n", "500 samples per frame", ns * FRAME_SAMPLES / RING_SIZE);
+    return 0;
+}
@@ -0,0 +1,105 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Per-report cost of conditioning two sticks and two triggers from raw ADC
+// counts, against the same steps in single precision floating point as
+// firmware did before. The host has an FPU, so only the fixed point figure
+// carries over: the RP2040 has none and runs every float operation in a
+// library call.
+
+#include "xinput_conditioning.hpp"
+#include "xinput_report.hpp"
+#include "xinput_test.hpp"
+
+#include <math.h>
+
+#define BENCH_ITERATIONS 5000000
+
+static constexpr xinput_curve_t curve = xinput_curve_expo(128);
+
+static const xinput_stick_config_t stick_config = {
+    { 100, 2048, 4000, false }, { 100, 2048, 4000, true }, 3000, 1500, true, &curve,
+};
+static const xinput_trigger_config_t trigger_config = { 200, 3800, 800, 0, &curve };
+
+// Floating point version of the same pipeline
+static void float_stick(uint16_t raw_x, uint16_t raw_y, int16_t *x, int16_t *y) {
+    float fx = ((float)raw_x - 2048) / (raw_x < 2048 ? 1948.0f : 1952.0f);
+    float fy = -((float)raw_y - 2048) / (raw_y > 2048 ? 1948.0f : 1952.0f);
+    const float magnitude = sqrtf(fx * fx + fy * fy);
+    const float deadzone = 3000 / 32767.0f, anti = 1500 / 32767.0f;
+    if (magnitude <= deadzone) {
+        *x = *y = 0;
+        return;
+    }
+    const float clamped = fminf(magnitude, 1.0f);
+    float out = anti + (clamped - deadzone) * (1 - anti) / (1 - deadzone);
+    out = out + (out * out * out - out) * (128 / 255.0f);
+    *x = (int16_t)(fx * out / magnitude * 32767);
+    *y = (int16_t)(fy * out / magnitude * 32767);
+}
+
+static uint8_t float_trigger(uint16_t raw) {
+    float value = fmaxf(0, fminf(1, ((float)raw - 200) / 3600));
+    if (value <= 800 / 32767.0f) {
+        return 0;
+    }
+    value = (value - 800 / 32767.0f) / (1 - 800 / 32767.0f);
+    value = value + (value * value * value - value) * (128 / 255.0f);
+    return (uint8_t)(value * 255);
+}
+
+int main(void) {
+    xinput_stick_t stick;
+    xinput_trigger_t trigger;
+    xinput_stick_init(&stick, &stick_config);
+    xinput_trigger_init(&trigger, &trigger_config);
+
+    static xinput_report_t report = {};
+
+    xinput_bench("fixed point, 2 sticks + 2 triggers", BENCH_ITERATIONS, [&](uint32_t i) {
+        const uint16_t a = (uint16_t)((i * 7) & 4095), b = (uint16_t)((i * 13) & 4095);
+        int16_t lx, ly, rx, ry;
+        xinput_stick_process(&stick, a, b, &lx, &ly);
+        xinput_stick_process(&stick, b, a, &rx, &ry);
+        xinput_report_set_sticks(&report, lx, ly, rx, ry);
+        xinput_report_set_triggers(
+            &report,
+            xinput_trigger_process(&trigger, a),
+            xinput_trigger_process(&trigger, b)
+        );
+        xinput_bench_keep(report);
+    });
+
+    xinput_bench("float, 2 sticks + 2 triggers", BENCH_ITERATIONS, [&](uint32_t i) {
+        const uint16_t a = (uint16_t)((i * 7) & 4095), b = (uint16_t)((i * 13) & 4095);
+        int16_t lx, ly, rx, ry;
+        float_stick(a, b, &lx, &ly);
+        float_stick(b, a, &rx, &ry);
+        xinput_report_set_sticks(&report, lx, ly, rx, ry);
+        xinput_report_set_triggers(&report, float_trigger(a), float_trigger(b));
+        xinput_bench_keep(report);
+    });
+    return 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Per-report cost of the adapter: translating a DualShock 4 style HID report,
+// and translating plus publishing it as xinput_hid_forward() does from the
+// host stack's report callback.
+
+#include "xinput_hid_adapter.hpp"
+#include "xinput_test.hpp"
+
+#define BENCH_ITERATIONS 5000000
+
+static Adafruit_USBD_XInput xinput;
+
+static const xinput_hid_map_t map = {
+    0x01,
+    {
+        { XINPUT_HID_NONE, 0 }, { XINPUT_HID_NONE, 0 }, { XINPUT_HID_NONE, 0 },
+        { XINPUT_HID_NONE, 0 }, { 5, 0x20 }, { 5, 0x10 }, { 5, 0x40 }, { 5, 0x80 },
+        { 5, 0x01 }, { 5, 0x02 }, { 6, 0x01 }, { XINPUT_HID_NONE, 0 },
+        { 4, 0x20 }, { 4, 0x40 }, { 4, 0x10 }, { 4, 0x80 },
+    },
+    4,
+    { 0, XINPUT_HID_AXIS_U8 },
+    { 1, XINPUT_HID_AXIS_U8 | XINPUT_HID_AXIS_INVERT },
+    { 2, XINPUT_HID_AXIS_U8 },
+    { 3, XINPUT_HID_AXIS_U8 | XINPUT_HID_AXIS_INVERT },
+    { 7, XINPUT_HID_AXIS_U8 },
+    { 8, XINPUT_HID_AXIS_U8 },
+};
+
+int main(void) {
+    static uint8_t hid[64] = { 0x01, 0x80, 0x80, 0x80, 0x80, 0x08 };
+    static xinput_report_t report;
+
+    xinput_bench("xinput_hid_translate", BENCH_ITERATIONS, [&](uint32_t i) {
+        hid[1] = (uint8_t)i;
+        hid[5] = (uint8_t)(i >> 3);
+        xinput_hid_translate(&map, hid, sizeof(hid), &report);
+        xinput_bench_keep(report);
+    });
+
+    if (!xinput.begin() || !xinput_test_attach()) {
+        return 1;
+    }
+    xinput_bench("xinput_hid_forward", BENCH_ITERATIONS, [&](uint32_t i) {
+        hid[1] = (uint8_t)i;
+        hid[5] = (uint8_t)(i >> 3);
+        xinput_hid_forward(&xinput, &map, hid, sizeof(hid));
+    });
+    return 0;
+}
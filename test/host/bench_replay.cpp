@@ -0,0 +1,86 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Replay throughput: a synthetic log of two million reports, one per
+// millisecond with the sticks sweeping and buttons changing now and then, is
+// pushed through the driver as fast as possible. Once with replay(), which
+// finds the IN endpoint busy for all but the first report, and once with the
+// host completing an IN transfer after every report, which exercises
+// sendReport() and the transfer callback for each of them.
+
+#include "xinput_recorder.hpp"
+#include "xinput_report.hpp"
+#include "xinput_test.hpp"
+
+#include <stdlib.h>
+
+#define REPLAY_REPORTS 2000000u
+
+static Adafruit_USBD_XInput xinput;
+
+int main(void) {
+    const uint32_t capacity = REPLAY_REPORTS * 16;
+    uint8_t *log = (uint8_t *)malloc(capacity);
+    xinput_recorder_t recorder;
+    xinput_recorder_init(&recorder, log, capacity);
+
+    xinput_report_t report = {};
+    report.report_size = sizeof(xinput_report_t);
+    for (uint32_t i = 0; i < REPLAY_REPORTS; i++) {
+        xinput_report_set_sticks(&report, (int16_t)(i * 97), (int16_t)(i * 89), 0, 0);
+        if (i % 64 == 0) {
+            xinput_report_set_buttons(&report, (uint16_t)(XINPUT_BUTTON_A << (i / 64 % 4)));
+        }
+        xinput_recorder_report(&recorder, i * 1000, &report);
+    }
+    if (recorder.dropped) {
+        return 1;
+    }
+    printf("%u reports in %u bytes\n", REPLAY_REPORTS, recorder.length);
+
+    if (!xinput.begin() || !xinput_test_attach()) {
+        return 1;
+    }
+    const uint8_t ep_in = mock_usbd_endpoint(0, TUSB_DIR_IN);
+    mock_usbd_in(ep_in, NULL, 0);
+
+    const auto start = std::chrono::steady_clock::now();
+    const uint32_t played = xinput.replay(log, recorder.length, false);
+    const std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    printf("%-40s %10.1f ns/op\n", "replay()", elapsed.count() / played);
+    mock_usbd_in(ep_in, NULL, 0);
+
+    xinput_log_reader_t reader;
+    xinput_log_record_t record;
+    xinput_log_reader_init(&reader, log, recorder.length);
+    xinput_bench("replay, host reads every report", REPLAY_REPORTS, [&](uint32_t) {
+        xinput_log_read(&reader, &record);
+        xinput.sendReport(record.report);
+        mock_usbd_in(ep_in, NULL, 0);
+    });
+
+    free(log);
+    return played == REPLAY_REPORTS ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Building a report from a GPIO bank and six axis values: field by field
+// through the xinput_report_t bitfields, as applications did before, against
+// the remap table and the packing helpers.
+
+#include "xinput_report.hpp"
+#include "xinput_test.hpp"
+
+#define BENCH_ITERATIONS 10000000
+
+static constexpr uint8_t pins[XINPUT_BUTTON_COUNT] = {
+    2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, XINPUT_PIN_NONE, 13, 14, 15, 16,
+};
+static constexpr xinput_button_remap_t remap = xinput_button_remap(pins);
+
+#define PIN(_gpio, _n) (((_gpio) >> (_n)) & 1)
+
+static void pack_fields(xinput_report_t *report, uint32_t gpio, int16_t axis, uint8_t trigger) {
+    report->dpad_up = PIN(gpio, 2);
+    report->dpad_down = PIN(gpio, 3);
+    report->dpad_left = PIN(gpio, 4);
+    report->dpad_right = PIN(gpio, 5);
+    report->start = PIN(gpio, 6);
+    report->back = PIN(gpio, 7);
+    report->ls = PIN(gpio, 8);
+    report->rs = PIN(gpio, 9);
+    report->lb = PIN(gpio, 10);
+    report->rb = PIN(gpio, 11);
+    report->home = PIN(gpio, 12);
+    report->a = PIN(gpio, 13);
+    report->b = PIN(gpio, 14);
+    report->x = PIN(gpio, 15);
+    report->y = PIN(gpio, 16);
+    report->lt = trigger;
+    report->rt = trigger;
+    report->lx = axis;
+    report->ly = axis;
+    report->rx = axis;
+    report->ry = axis;
+}
+
+static void pack_word(xinput_report_t *report, uint32_t gpio, int16_t axis, uint8_t trigger) {
+    xinput_report_set_buttons(report, xinput_button_remap_apply(&remap, gpio));
+    xinput_report_set_triggers(report, trigger, trigger);
+    xinput_report_set_sticks(report, axis, axis, axis, axis);
+}
+
+int main(void) {
+    static xinput_report_t report = {};
+
+    // Both must produce the same report before their cost is compared
+    for (uint32_t gpio = 0; gpio < (1u << 17); gpio += 3) {
+        xinput_report_t a = {}, b = {};
+        pack_fields(&a, gpio, (int16_t)gpio, (uint8_t)gpio);
+        pack_word(&b, gpio, (int16_t)gpio, (uint8_t)gpio);
+        if (memcmp(&a, &b, sizeof(a)) != 0) {
+            fprintf(stderr, "packing mismatch for gpio 0x%08x\n", gpio);
+            return 1;
+        }
+    }
+
+    xinput_bench("field by field", BENCH_ITERATIONS, [](uint32_t i) {
+        pack_fields(&report, i * 2654435761u, (int16_t)i, (uint8_t)i);
+        xinput_bench_keep(report);
+    });
+    xinput_bench("remap + packed word", BENCH_ITERATIONS, [](uint32_t i) {
+        pack_word(&report, i * 2654435761u, (int16_t)i, (uint8_t)i);
+        xinput_bench_keep(report);
+    });
+    return 0;
+}
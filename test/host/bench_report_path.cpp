@@ -0,0 +1,87 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Cost of the driver hot paths against the mock device stack: sendReport()
+// with and without an IN transfer in flight, a full send and IN completion
+// round trip, the interface descriptor parse in xinput_open() and a vendor
+// control request. Mock overhead is included; compare runs, not absolutes.
+
+#include "xinput_test.hpp"
+
+static Adafruit_USBD_XInput xinput;
+
+int main(void) {
+    if (!xinput.begin() || !xinput_test_attach()) {
+        return 1;
+    }
+    const uint8_t ep_in = mock_usbd_endpoint(0, TUSB_DIR_IN);
+    mock_usbd_in(ep_in, NULL, 0);
+
+    xinput_report_t report = {};
+    report.report_size = sizeof(xinput_report_t);
+
+    // Endpoint busy: the report only goes into the triple buffer
+    xinput.sendReport(&report);
+    xinput_bench("sendReport (IN busy)", 1000000, [&](uint32_t i) {
+        report.lx = (int16_t)i;
+        xinput.sendReport(&report);
+    });
+
+    xinput_bench("sendReport + IN completion", 1000000, [&](uint32_t i) {
+        report.lx = (int16_t)i;
+        xinput.sendReport(&report);
+        mock_usbd_in(ep_in, NULL, 0);
+    });
+
+    xinput_bench("publishReport", 1000000, [&](uint32_t i) {
+        report.lx = (int16_t)i;
+        xinput.publishReport(&report);
+    });
+
+    // Reopening parses the interface, HID and endpoint descriptors
+    const uint8_t *itf = TinyUSBDevice._desc_cfg;
+    const uint16_t itf_len = TinyUSBDevice._desc_cfg_len;
+    xinput_bench("xinput_open", 200000, [&](uint32_t) {
+        mock_usbd_bus_reset();
+        uint8_t count;
+        xinput_bench_keep(
+            usbd_app_driver_get_cb(&count)->open(0, (const tusb_desc_interface_t *)itf, itf_len)
+        );
+    });
+
+    const tusb_control_request_t ms_os_20 = xinput_test_request(0xC0, 1, 0x0000, 0x0007, 0xB2);
+    uint8_t data[256];
+    xinput_bench("vendor control (MS OS 2.0)", 1000000, [&](uint32_t) {
+        xinput_bench_keep(mock_usbd_control(&ms_os_20, data, NULL));
+    });
+
+    const tusb_control_request_t capabilities = xinput_test_request(0xC1, 1, 0x0000, 0x0000, 8);
+    xinput_bench("vendor control (output capabilities)", 1000000, [&](uint32_t) {
+        xinput_bench_keep(mock_usbd_control(&capabilities, data, NULL));
+    });
+
+    // Every request above has to be answered, a stall would be measuring the
+    // wrong path
+    return mock_usbd_counters()->control_stalled ? 1 : 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Cost of one debounced scan of the GPIO bank into the button word, with the
+// vertical counter against the same debouncing done one button at a time.
+// The scanner costs the same for any number of wired buttons.
+
+#include "xinput_scanner.hpp"
+#include "xinput_test.hpp"
+
+#define BENCH_ITERATIONS 10000000
+#define DEBOUNCE_SCANS 4
+
+static constexpr uint8_t pins[XINPUT_BUTTON_COUNT] = {
+    2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, XINPUT_PIN_NONE, 13, 14, 15, 16,
+};
+static constexpr xinput_button_remap_t remap = xinput_button_remap(pins);
+
+// Per button integrator and bitfield-style packing, as hand-written loops did
+typedef struct {
+    uint8_t count[XINPUT_BUTTON_COUNT];
+    uint16_t buttons;
+} per_button_t;
+
+static uint16_t per_button_update(per_button_t *scan, uint32_t gpio) {
+    for (uint8_t bit = 0; bit < XINPUT_BUTTON_COUNT; bit++) {
+        if (pins[bit] == XINPUT_PIN_NONE) {
+            continue;
+        }
+        const bool raw = (gpio >> pins[bit]) & 1;
+        const bool state = (scan->buttons >> bit) & 1;
+        if (raw != state) {
+            if (++scan->count[bit] == DEBOUNCE_SCANS) {
+                scan->buttons ^= (uint16_t)(1u << bit);
+                scan->count[bit] = 0;
+            }
+        } else {
+            scan->count[bit] = 0;
+        }
+    }
+    return scan->buttons;
+}
+
+// Bouncy input: the low bits change every scan, the rest now and then
+static inline uint32_t bench_gpio(uint32_t i) {
+    return (i * 2654435761u) & (i & 64 ? 0xFFFFFFFF : 0x1F);
+}
+
+int main(void) {
+    xinput_scanner_t scanner;
+    xinput_scanner_init(&scanner, &remap, 0);
+    static per_button_t per_button = {};
+
+    xinput_bench("vertical counter scan", BENCH_ITERATIONS, [&](uint32_t i) {
+        xinput_bench_keep(xinput_scanner_update(&scanner, bench_gpio(i)));
+    });
+    xinput_bench("per-button scan", BENCH_ITERATIONS, [&](uint32_t i) {
+        xinput_bench_keep(per_button_update(&per_button, bench_gpio(i)));
+    });
+    return 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef MOCK_ADAFRUIT_USBD_DEVICE_H_
+#define MOCK_ADAFRUIT_USBD_DEVICE_H_
+
+#include "device/usbd_pvt.h"
+
+#include <stdint.h>
+
+// Adafruit TinyUSB device class stand-in. addInterface() assembles the
+// configuration descriptor the same way the library does, including the
+// endpoint number assignment, so mock_usbd_configure() can open the
+// interfaces from it like TinyUSB does on SET_CONFIGURATION.
+
+class Adafruit_USBD_Interface {
+  public:
+    virtual ~Adafruit_USBD_Interface() {}
+
+    virtual uint16_t getInterfaceDescriptor(uint8_t itfnum, uint8_t *buf, uint16_t bufsize) = 0;
+};
+
+#define MOCK_USBD_CONFIG_MAX 512
+
+class Adafruit_USBD_Device {
+  public:
+    bool addInterface(Adafruit_USBD_Interface &itf);
+    void setVersion(uint16_t bcd) { _bcd_usb = bcd; }
+    bool mounted(void) { return tud_mounted(); }
+
+    uint16_t _bcd_usb = 0x0200;
+    uint8_t _itf_count = 0;
+    uint8_t _epin_count = 1;
+    uint8_t _epout_count = 1;
+    uint8_t _desc_cfg[MOCK_USBD_CONFIG_MAX] = {};
+    uint16_t _desc_cfg_len = 0;
+};
+
+extern Adafruit_USBD_Device TinyUSBDevice;
+
+#endif /* MOCK_ADAFRUIT_USBD_DEVICE_H_ */
@@ -0,0 +1,260 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef MOCK_USBD_PVT_H_
+#define MOCK_USBD_PVT_H_
+
+#include "tusb_option.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// The subset of the TinyUSB device stack API used by the XInput driver, with
+// the same names, types and semantics. The implementation in mock_usbd.cpp
+// stands in for the device controller, see mock_usbd.h for the test side.
+
+#define TU_ATTR_PACKED __attribute__((packed))
+#define TU_ATTR_WEAK __attribute__((weak))
+#define TU_ATTR_ALIGNED(_bytes) __attribute__((aligned(_bytes)))
+
+#define TU_U16_HIGH(_u16) ((uint8_t)(((_u16) >> 8) & 0x00ff))
+#define TU_U16_LOW(_u16) ((uint8_t)((_u16) & 0x00ff))
+#define U16_TO_U8S_LE(_u16) TU_U16_LOW(_u16), TU_U16_HIGH(_u16)
+#define U32_TO_U8S_LE(_u32)                                                    \
+    ((uint8_t)((_u32) & 0xff)), ((uint8_t)(((_u32) >> 8) & 0xff)),             \
+        ((uint8_t)(((_u32) >> 16) & 0xff)), ((uint8_t)(((_u32) >> 24) & 0xff))
+
+static inline uint16_t tu_u16(uint8_t high, uint8_t low) {
+    return (uint16_t)((((uint16_t)high) << 8) | low);
+}
+
+// TU_VERIFY(cond) returns false, TU_VERIFY(cond, ret) returns ret
+#define TU_GET_3RD_ARG(_1, _2, _3, ...) _3
+#define TU_VERIFY_1ARG(_cond) \
+    do {                      \
+        if (!(_cond))         \
+            return false;     \
+    } while (0)
+#define TU_VERIFY_2ARGS(_cond, _ret) \
+    do {                             \
+        if (!(_cond))                \
+            return _ret;             \
+    } while (0)
+#define TU_VERIFY(...) TU_GET_3RD_ARG(__VA_ARGS__, TU_VERIFY_2ARGS, TU_VERIFY_1ARG, )(__VA_ARGS__)
+#define TU_ASSERT TU_VERIFY
+
+//--------------------------------------------------------------------+
+// Types
+//--------------------------------------------------------------------+
+
+typedef enum {
+    TUSB_DESC_DEVICE = 0x01,
+    TUSB_DESC_CONFIGURATION = 0x02,
+    TUSB_DESC_STRING = 0x03,
+    TUSB_DESC_INTERFACE = 0x04,
+    TUSB_DESC_ENDPOINT = 0x05,
+    TUSB_DESC_BOS = 0x0F,
+    TUSB_DESC_DEVICE_CAPABILITY = 0x10,
+} tusb_desc_type_t;
+
+typedef enum {
+    TUSB_XFER_CONTROL = 0,
+    TUSB_XFER_ISOCHRONOUS,
+    TUSB_XFER_BULK,
+    TUSB_XFER_INTERRUPT,
+} tusb_xfer_type_t;
+
+typedef enum {
+    TUSB_DIR_OUT = 0,
+    TUSB_DIR_IN = 1,
+    TUSB_DIR_IN_MASK = 0x80,
+} tusb_dir_t;
+
+typedef enum {
+    TUSB_REQ_TYPE_STANDARD = 0,
+    TUSB_REQ_TYPE_CLASS,
+    TUSB_REQ_TYPE_VENDOR,
+    TUSB_REQ_TYPE_INVALID,
+} tusb_request_type_t;
+
+typedef enum {
+    TUSB_REQ_RCPT_DEVICE = 0,
+    TUSB_REQ_RCPT_INTERFACE,
+    TUSB_REQ_RCPT_ENDPOINT,
+    TUSB_REQ_RCPT_OTHER,
+} tusb_request_recipient_t;
+
+typedef enum {
+    XFER_RESULT_SUCCESS = 0,
+    XFER_RESULT_FAILED,
+    XFER_RESULT_STALLED,
+    XFER_RESULT_TIMEOUT,
+    XFER_RESULT_INVALID,
+} xfer_result_t;
+
+enum {
+    CONTROL_STAGE_IDLE,
+    CONTROL_STAGE_SETUP,
+    CONTROL_STAGE_DATA,
+    CONTROL_STAGE_ACK,
+};
+
+#define TUSB_CLASS_VENDOR_SPECIFIC 0xFF
+#define HID_DESC_TYPE_HID 0x21
+
+typedef struct TU_ATTR_PACKED {
+    uint8_t bLength;
+    uint8_t bDescriptorType;
+    uint8_t bInterfaceNumber;
+    uint8_t bAlternateSetting;
+    uint8_t bNumEndpoints;
+    uint8_t bInterfaceClass;
+    uint8_t bInterfaceSubClass;
+    uint8_t bInterfaceProtocol;
+    uint8_t iInterface;
+} tusb_desc_interface_t;
+
+typedef struct TU_ATTR_PACKED {
+    uint8_t bLength;
+    uint8_t bDescriptorType;
+    uint8_t bEndpointAddress;
+    uint8_t bmAttributes;
+    uint16_t wMaxPacketSize;
+    uint8_t bInterval;
+} tusb_desc_endpoint_t;
+
+typedef struct TU_ATTR_PACKED {
+    union {
+        struct TU_ATTR_PACKED {
+            uint8_t recipient : 5;
+            uint8_t type : 2;
+            uint8_t direction : 1;
+        } bmRequestType_bit;
+
+        uint8_t bmRequestType;
+    };
+
+    uint8_t bRequest;
+    uint16_t wValue;
+    uint16_t wIndex;
+    uint16_t wLength;
+} tusb_control_request_t;
+
+static_assert(sizeof(tusb_control_request_t) == 8, "control request layout");
+
+static inline const uint8_t *tu_desc_next(const void *desc) {
+    const uint8_t *desc8 = (const uint8_t *)desc;
+    return desc8 + desc8[0];
+}
+
+static inline uint8_t tu_desc_type(const void *desc) {
+    return ((const uint8_t *)desc)[1];
+}
+
+static inline tusb_dir_t tu_edpt_dir(uint8_t addr) {
+    return (addr & TUSB_DIR_IN_MASK) ? TUSB_DIR_IN : TUSB_DIR_OUT;
+}
+
+static inline uint8_t tu_edpt_number(uint8_t addr) {
+    return (uint8_t)(addr & (~TUSB_DIR_IN_MASK));
+}
+
+//--------------------------------------------------------------------+
+// BOS and MS OS 2.0 descriptors
+//--------------------------------------------------------------------+
+
+#define TUD_BOS_DESC_LEN 5
+#define TUD_BOS_DESCRIPTOR(_total_len, _caps_num)          \
+    5, TUSB_DESC_BOS, U16_TO_U8S_LE(_total_len), _caps_num
+
+#define TUD_BOS_MICROSOFT_OS_DESC_LEN 28
+#define TUD_BOS_MS_OS_20_UUID                                                                      \
+    0xDF, 0x60, 0xDD, 0xD8, 0x89, 0x45, 0xC7, 0x4C, 0x9C, 0xD2, 0x65, 0x9D, 0x9E, 0x64, 0x8A, 0x9F
+#define TUD_BOS_MS_OS_20_DESCRIPTOR(_desc_set_len, _vendor_code)                        \
+    TUD_BOS_MICROSOFT_OS_DESC_LEN, TUSB_DESC_DEVICE_CAPABILITY, 0x05, 0x00,             \
+        TUD_BOS_MS_OS_20_UUID, U32_TO_U8S_LE(0x06030000), U16_TO_U8S_LE(_desc_set_len), \
+        _vendor_code, 0
+
+enum {
+    MS_OS_20_SET_HEADER_DESCRIPTOR = 0x00,
+    MS_OS_20_SUBSET_HEADER_CONFIGURATION = 0x01,
+    MS_OS_20_SUBSET_HEADER_FUNCTION = 0x02,
+    MS_OS_20_FEATURE_COMPATBLE_ID = 0x03,
+    MS_OS_20_FEATURE_REG_PROPERTY = 0x04,
+};
+
+//--------------------------------------------------------------------+
+// Device stack
+//--------------------------------------------------------------------+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    void (*init)(void);
+    void (*reset)(uint8_t rhport);
+    uint16_t (*open)(uint8_t rhport, const tusb_desc_interface_t *desc_intf, uint16_t max_len);
+    bool (*control_xfer_cb)(uint8_t rhport, uint8_t stage, const tusb_control_request_t *request);
+    bool (*xfer_cb)(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes);
+    void (*sof)(uint8_t rhport, uint32_t frame_count);
+} usbd_class_driver_t;
+
+bool usbd_edpt_open(uint8_t rhport, const tusb_desc_endpoint_t *desc_ep);
+bool usbd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t *buffer, uint16_t total_bytes);
+bool usbd_edpt_busy(uint8_t rhport, uint8_t ep_addr);
+bool usbd_edpt_claim(uint8_t rhport, uint8_t ep_addr);
+bool usbd_edpt_release(uint8_t rhport, uint8_t ep_addr);
+void usbd_sof_enable(uint8_t rhport, bool en);
+
+bool tud_mounted(void);
+bool tud_suspended(void);
+bool tud_remote_wakeup(void);
+bool tud_control_xfer(
+    uint8_t rhport,
+    const tusb_control_request_t *request,
+    void *buffer,
+    uint16_t len
+);
+
+static inline bool tud_ready(void) {
+    return tud_mounted() && !tud_suspended();
+}
+
+// Application callbacks, implemented by the driver
+const usbd_class_driver_t *usbd_app_driver_get_cb(uint8_t *driver_count);
+const uint8_t *tud_descriptor_bos_cb(void);
+bool tud_vendor_control_xfer_cb(
+    uint8_t rhport,
+    uint8_t stage,
+    const tusb_control_request_t *request
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MOCK_USBD_PVT_H_ */
@@ -0,0 +1,416 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "mock_usbd.h"
+
+#include "arduino/Adafruit_USBD_Device.h"
+
+#include <Arduino.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+Adafruit_USBD_Device TinyUSBDevice;
+
+typedef struct {
+    bool opened;
+    bool busy;
+    bool claimed;
+    bool fail_next;
+    uint8_t *buffer;
+    uint16_t length;
+} mock_edpt_t;
+
+static std::mutex _mock_mutex;
+static mock_edpt_t _mock_edpt[16][2] = {};
+static bool _mock_mounted = false;
+static bool _mock_suspended = false;
+static bool _mock_remote_wakeup_en = false;
+static bool _mock_sof_enabled = false;
+static uint32_t _mock_frame = 0;
+static mock_usbd_counters_t _mock_counters = {};
+
+// Data stage of the control request being processed
+static uint8_t *_mock_control_data = NULL;
+static uint16_t _mock_control_len = 0;
+
+static std::atomic<uint32_t> _mock_time_us(0);
+
+static inline mock_edpt_t *mock_edpt(uint8_t ep_addr) {
+    return &_mock_edpt[tu_edpt_number(ep_addr) & 0x0F][tu_edpt_dir(ep_addr)];
+}
+
+static const usbd_class_driver_t *mock_driver(void) {
+    uint8_t count = 0;
+    const usbd_class_driver_t *driver = usbd_app_driver_get_cb(&count);
+    return count ? driver : NULL;
+}
+
+//--------------------------------------------------------------------+
+// Arduino
+//--------------------------------------------------------------------+
+
+uint32_t micros(void) {
+    return _mock_time_us.load(std::memory_order_relaxed);
+}
+
+uint32_t millis(void) {
+    return micros() / 1000;
+}
+
+void delay(uint32_t ms) {
+    mock_time_advance_us(ms * 1000);
+}
+
+void yield(void) {
+    mock_time_advance_us(1);
+}
+
+void mock_time_set_us(uint32_t now_us) {
+    _mock_time_us.store(now_us, std::memory_order_relaxed);
+}
+
+void mock_time_advance_us(uint32_t delta_us) {
+    _mock_time_us.fetch_add(delta_us, std::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------+
+// Adafruit TinyUSB
+//--------------------------------------------------------------------+
+
+bool Adafruit_USBD_Device::addInterface(Adafruit_USBD_Interface &itf) {
+    uint8_t *desc = _desc_cfg + _desc_cfg_len;
+    const uint16_t len =
+        itf.getInterfaceDescriptor(_itf_count, desc, MOCK_USBD_CONFIG_MAX - _desc_cfg_len);
+    if (!len) {
+        return false;
+    }
+
+    // Same numbering as the library: interfaces in order, endpoint numbers
+    // ORed into the template addresses per direction
+    for (uint8_t *p = desc; p < desc + len; p += p[0]) {
+        if (p[0] == 0) {
+            return false;
+        }
+        if (p[1] == TUSB_DESC_INTERFACE && ((tusb_desc_interface_t *)p)->bAlternateSetting == 0) {
+            _itf_count++;
+        } else if (p[1] == TUSB_DESC_ENDPOINT) {
+            tusb_desc_endpoint_t *ep = (tusb_desc_endpoint_t *)p;
+            ep->bEndpointAddress |= (ep->bEndpointAddress & TUSB_DIR_IN_MASK) ? _epin_count++
+                                                                              : _epout_count++;
+        }
+    }
+
+    _desc_cfg_len += len;
+    return true;
+}
+
+//--------------------------------------------------------------------+
+// TinyUSB device stack
+//--------------------------------------------------------------------+
+
+extern "C" {
+
+bool usbd_edpt_open(uint8_t rhport, const tusb_desc_endpoint_t *desc_ep) {
+    (void)rhport;
+    std::lock_guard<std::mutex> lock(_mock_mutex);
+    mock_edpt_t *ep = mock_edpt(desc_ep->bEndpointAddress);
+    *ep = {};
+    ep->opened = true;
+    return true;
+}
+
+bool usbd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t *buffer, uint16_t total_bytes) {
+    (void)rhport;
+    std::lock_guard<std::mutex> lock(_mock_mutex);
+    mock_edpt_t *ep = mock_edpt(ep_addr);
+
+    if (!ep->opened || ep->busy) {
+        _mock_counters.xfer_violations++;
+        return false;
+    }
+
+    if (ep->fail_next) {
+        ep->fail_next = false;
+        ep->claimed = false;
+        _mock_counters.xfers_failed++;
+        return false;
+    }
+
+    ep->busy = true;
+    ep->buffer = buffer;
+    ep->length = total_bytes;
+    _mock_counters.xfers++;
+    return true;
+}
+
+bool usbd_edpt_busy(uint8_t rhport, uint8_t ep_addr) {
+    (void)rhport;
+    std::lock_guard<std::mutex> lock(_mock_mutex);
+    return mock_edpt(ep_addr)->busy;
+}
+
+bool usbd_edpt_claim(uint8_t rhport, uint8_t ep_addr) {
+    (void)rhport;
+    std::lock_guard<std::mutex> lock(_mock_mutex);
+    mock_edpt_t *ep = mock_edpt(ep_addr);
+    const bool available = !ep->busy && !ep->claimed;
+    if (available) {
+        ep->claimed = true;
+    } else {
+        _mock_counters.claims_rejected++;
+    }
+    return available;
+}
+
+bool usbd_edpt_release(uint8_t rhport, uint8_t ep_addr) {
+    (void)rhport;
+    std::lock_guard<std::mutex> lock(_mock_mutex);
+    mock_edpt_t *ep = mock_edpt(ep_addr);
+    const bool claimed = ep->claimed;
+    ep->claimed = false;
+    return claimed;
+}
+
+void usbd_sof_enable(uint8_t rhport, bool en) {
+    (void)rhport;
+    _mock_sof_enabled = en;
+}
+
+bool tud_mounted(void) {
+    return _mock_mounted;
+}
+
+bool tud_suspended(void) {
+    return _mock_suspended;
+}
+
+bool tud_remote_wakeup(void) {
+    if (!_mock_suspended || !_mock_remote_wakeup_en) {
+        return false;
+    }
+    _mock_counters.remote_wakeups++;
+    return true;
+}
+
+bool tud_control_xfer(
+    uint8_t rhport,
+    const tusb_control_request_t *request,
+    void *buffer,
+    uint16_t len
+) {
+    (void)rhport;
+    const uint16_t length = len < request->wLength ? len : request->wLength;
+    if (_mock_control_data) {
+        memcpy(_mock_control_data, buffer, length);
+    }
+    _mock_control_len = length;
+    return true;
+}
+
+} // extern "C"
+
+//--------------------------------------------------------------------+
+// Test side
+//--------------------------------------------------------------------+
+
+void mock_usbd_init(void) {
+    const usbd_class_driver_t *driver = mock_driver();
+    if (driver && driver->init) {
+        driver->init();
+    }
+}
+
+void mock_usbd_bus_reset(void) {
+    {
+        std::lock_guard<std::mutex> lock(_mock_mutex);
+        memset(_mock_edpt, 0, sizeof(_mock_edpt));
+    }
+    _mock_mounted = false;
+    _mock_suspended = false;
+    _mock_remote_wakeup_en = false;
+    _mock_sof_enabled = false;
+
+    const usbd_class_driver_t *driver = mock_driver();
+    if (driver) {
+        driver->reset(TUD_OPT_RHPORT);
+    }
+}
+
+bool mock_usbd_configure(void) {
+    const usbd_class_driver_t *driver = mock_driver();
+    TU_VERIFY(driver);
+
+    const uint8_t *p = TinyUSBDevice._desc_cfg;
+    const uint8_t *end = p + TinyUSBDevice._desc_cfg_len;
+    while (p < end) {
+        TU_VERIFY(tu_desc_type(p) == TUSB_DESC_INTERFACE);
+        const uint16_t len =
+            driver->open(TUD_OPT_RHPORT, (const tusb_desc_interface_t *)p, (uint16_t)(end - p));
+        TU_VERIFY(len >= sizeof(tusb_desc_interface_t) && len <= end - p);
+        p += len;
+    }
+
+    _mock_mounted = true;
+    return true;
+}
+
+void mock_usbd_suspend(bool suspended) {
+    _mock_suspended = suspended;
+}
+
+void mock_usbd_set_remote_wakeup(bool enabled) {
+    _mock_remote_wakeup_en = enabled;
+}
+
+uint8_t mock_usbd_endpoint(uint8_t itfnum, tusb_dir_t dir) {
+    const uint8_t *p = TinyUSBDevice._desc_cfg;
+    const uint8_t *end = p + TinyUSBDevice._desc_cfg_len;
+    bool in_itf = false;
+    for (; p < end; p = tu_desc_next(p)) {
+        if (tu_desc_type(p) == TUSB_DESC_INTERFACE) {
+            in_itf = ((const tusb_desc_interface_t *)p)->bInterfaceNumber == itfnum;
+        } else if (in_itf && tu_desc_type(p) == TUSB_DESC_ENDPOINT) {
+            const uint8_t addr = ((const tusb_desc_endpoint_t *)p)->bEndpointAddress;
+            if (tu_edpt_dir(addr) == dir) {
+                return addr;
+            }
+        }
+    }
+    return 0;
+}
+
+bool mock_usbd_armed(uint8_t ep_addr) {
+    std::lock_guard<std::mutex> lock(_mock_mutex);
+    return mock_edpt(ep_addr)->busy;
+}
+
+int mock_usbd_in(uint8_t ep_addr, uint8_t *data, uint16_t size) {
+    uint16_t length;
+    {
+        std::lock_guard<std::mutex> lock(_mock_mutex);
+        mock_edpt_t *ep = mock_edpt(ep_addr);
+        if (!ep->busy) {
+            return -1;
+        }
+        length = ep->length < size ? ep->length : size;
+
+        // The controller reads the buffer while the packet is on the wire.
+        // Giving other threads a chance mid-copy makes a buffer written in
+        // flight show up as a torn packet even on a single CPU.
+        if (data) {
+            memcpy(data, ep->buffer, length / 2);
+            std::this_thread::yield();
+            memcpy(data + length / 2, ep->buffer + length / 2, length - length / 2);
+        }
+        ep->busy = false;
+        ep->claimed = false;
+    }
+
+    mock_driver()->xfer_cb(TUD_OPT_RHPORT, ep_addr, XFER_RESULT_SUCCESS, length);
+    return length;
+}
+
+bool mock_usbd_in_fail(uint8_t ep_addr, xfer_result_t result) {
+    {
+        std::lock_guard<std::mutex> lock(_mock_mutex);
+        mock_edpt_t *ep = mock_edpt(ep_addr);
+        if (!ep->busy) {
+            return false;
+        }
+        ep->busy = false;
+        ep->claimed = false;
+    }
+
+    mock_driver()->xfer_cb(TUD_OPT_RHPORT, ep_addr, result, 0);
+    return true;
+}
+
+bool mock_usbd_out(uint8_t ep_addr, const uint8_t *data, uint16_t len) {
+    {
+        std::lock_guard<std::mutex> lock(_mock_mutex);
+        mock_edpt_t *ep = mock_edpt(ep_addr);
+        if (!ep->busy) {
+            return false;
+        }
+        len = len < ep->length ? len : ep->length;
+        memcpy(ep->buffer, data, len);
+        ep->busy = false;
+        ep->claimed = false;
+    }
+
+    mock_driver()->xfer_cb(TUD_OPT_RHPORT, ep_addr, XFER_RESULT_SUCCESS, len);
+    return true;
+}
+
+void mock_usbd_sof(void) {
+    _mock_frame++;
+    const usbd_class_driver_t *driver = mock_driver();
+    if (_mock_sof_enabled && driver->sof) {
+        driver->sof(TUD_OPT_RHPORT, _mock_frame & 0x7FF);
+    }
+}
+
+bool mock_usbd_sof_enabled(void) {
+    return _mock_sof_enabled;
+}
+
+bool mock_usbd_control(const tusb_control_request_t *request, uint8_t *data, uint16_t *len) {
+    _mock_control_data = data;
+    _mock_control_len = 0;
+
+    // Like usbd.c: vendor requests go to the application callback before
+    // any dispatch by recipient, interface requests to the class driver
+    bool answered = false;
+    if (request->bmRequestType_bit.type == TUSB_REQ_TYPE_VENDOR) {
+        answered = tud_vendor_control_xfer_cb(TUD_OPT_RHPORT, CONTROL_STAGE_SETUP, request);
+        if (answered) {
+            tud_vendor_control_xfer_cb(TUD_OPT_RHPORT, CONTROL_STAGE_ACK, request);
+        }
+    } else if (request->bmRequestType_bit.recipient == TUSB_REQ_RCPT_INTERFACE) {
+        const usbd_class_driver_t *driver = mock_driver();
+        answered = driver->control_xfer_cb(TUD_OPT_RHPORT, CONTROL_STAGE_SETUP, request);
+    }
+
+    answered ? _mock_counters.control_answered++ : _mock_counters.control_stalled++;
+    if (len) {
+        *len = answered ? _mock_control_len : 0;
+    }
+    _mock_control_data = NULL;
+    return answered;
+}
+
+void mock_usbd_fail_next_xfer(uint8_t ep_addr) {
+    std::lock_guard<std::mutex> lock(_mock_mutex);
+    mock_edpt(ep_addr)->fail_next = true;
+}
+
+const mock_usbd_counters_t *mock_usbd_counters(void) {
+    return &_mock_counters;
+}
+
+void mock_usbd_clear_counters(void) {
+    _mock_counters = {};
+}
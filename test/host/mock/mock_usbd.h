@@ -0,0 +1,91 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef MOCK_USBD_H_
+#define MOCK_USBD_H_
+
+#include "device/usbd_pvt.h"
+
+#include <stdint.h>
+
+// Test side of the mock device controller. Each call plays one bus event into
+// the class driver the way the TinyUSB device task would, so it must be made
+// from the thread acting as the USB task.
+
+typedef struct {
+    uint32_t xfers;            // transfers started with usbd_edpt_xfer()
+    uint32_t xfers_failed;     // rejected by the controller, see mock_usbd_fail_next_xfer()
+    uint32_t xfer_violations;  // started while the endpoint was busy or not open
+    uint32_t claims_rejected;  // usbd_edpt_claim() calls that failed
+    uint32_t control_answered; // SETUP stages answered with tud_control_xfer()
+    uint32_t control_stalled;  // SETUP stages stalled
+    uint32_t remote_wakeups;   // tud_remote_wakeup() calls that signalled resume
+} mock_usbd_counters_t;
+
+// Calls the driver's init, the first thing tud_init() does
+void mock_usbd_init(void);
+
+// Bus reset: closes all endpoints, unmounts and calls the driver's reset
+void mock_usbd_bus_reset(void);
+
+// SET_CONFIGURATION: opens every interface added to TinyUSBDevice through the
+// driver's open callback and mounts the device
+bool mock_usbd_configure(void);
+
+void mock_usbd_suspend(bool suspended);
+void mock_usbd_set_remote_wakeup(bool enabled);
+
+// Endpoint address assigned to an interface by TinyUSBDevice.addInterface()
+uint8_t mock_usbd_endpoint(uint8_t itfnum, tusb_dir_t dir);
+
+bool mock_usbd_armed(uint8_t ep_addr);
+
+// The host polls an IN endpoint. If a transfer is armed its data is copied to
+// data, the transfer completes and the driver's transfer callback runs.
+// Returns the length, or -1 if the endpoint NAKed.
+int mock_usbd_in(uint8_t ep_addr, uint8_t *data, uint16_t size);
+
+// The armed IN transfer ends with result, e.g. XFER_RESULT_STALLED, without
+// the host receiving it. False if no transfer was armed.
+bool mock_usbd_in_fail(uint8_t ep_addr, xfer_result_t result);
+
+// The host writes to an OUT endpoint, false if it NAKed
+bool mock_usbd_out(uint8_t ep_addr, const uint8_t *data, uint16_t len);
+
+// Start of frame, delivered to the driver if it enabled SOF
+void mock_usbd_sof(void);
+bool mock_usbd_sof_enabled(void);
+
+// Runs a control request through the stack's dispatch. Returns false if it
+// was stalled, otherwise the data stage is copied to data and its length to
+// len (both optional).
+bool mock_usbd_control(const tusb_control_request_t *request, uint8_t *data, uint16_t *len);
+
+// Makes the next usbd_edpt_xfer() on ep_addr fail in the controller
+void mock_usbd_fail_next_xfer(uint8_t ep_addr);
+
+const mock_usbd_counters_t *mock_usbd_counters(void);
+void mock_usbd_clear_counters(void);
+
+#endif /* MOCK_USBD_H_ */
@@ -0,0 +1,301 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Discrete-event simulation of how the submission strategy of an application
+// translates into input age at the host. Virtual time drives four event
+// streams against the driver and the mock device stack:
+//
+//   - input changes at a jittered rate, each one numbered,
+//   - the application loop, which samples inputs every SIM_LOOP_US with jitter,
+//   - SOF at every 1 ms frame boundary,
+//   - the host reading the IN endpoint once every interval_ms frames, at a
+//     jittered phase after SOF.
+//
+// The same workload is played in three modes:
+//
+//   immediate  the loop sends only when ready() and the state changed, the
+//              classic pattern where reports are not queued behind a busy
+//              endpoint
+//   coalesced  the loop sends every change, the driver keeps the newest one
+//              pending until the in-flight transfer completes
+//   latched    inputs are sampled and sent from the latch callback only. The
+//              host build has no timer alarms, so the callback runs at the SOF
+//              of the polled frame as on targets other than RP2040; RP2040
+//              additionally delays it until lead_us before the expected poll.
+//
+// Reports carry the number of the newest input applied. When the host reads
+// one, every input up to that number is resolved: the newest is delivered with
+// the read time minus its change time as latency, the older ones were
+// superseded before the host ever saw them and count as missed updates.
+//
+//   sim_host_polling [interval_ms [csv_path]]
+//
+// prints a summary per mode and, with csv_path, writes one row per input
+// change: mode,interval_ms,event,event_us,read_us,latency_us, with read_us
+// and latency_us empty for missed updates.
+
+#include "xinput_test.hpp"
+
+#include <algorithm>
+#include <stdlib.h>
+#include <vector>
+
+#define SIM_FRAMES 20000
+#define SIM_FRAME_US 1000
+#define SIM_INPUT_PERIOD_US 4000
+#define SIM_INPUT_JITTER_US 3000
+#define SIM_LOOP_US 500
+#define SIM_LOOP_JITTER_US 100
+#define SIM_POLL_PHASE_US 300
+#define SIM_POLL_JITTER_US 50
+#define SIM_SEED 0x2545F491u
+
+enum sim_mode_t { SIM_IMMEDIATE, SIM_COALESCED, SIM_LATCHED };
+
+static const char *const sim_mode_names[] = { "immediate", "coalesced", "latched" };
+
+typedef struct {
+    uint32_t event_us;
+    uint32_t read_us; // 0 while pending or if superseded
+    bool missed;
+} sim_input_t;
+
+static Adafruit_USBD_XInput *xinput;
+static std::vector<sim_input_t> inputs;
+static uint32_t sent_input;
+
+// xorshift32, so every mode sees exactly the same workload
+static uint32_t sim_random_state;
+
+static uint32_t sim_random(void) {
+    sim_random_state ^= sim_random_state << 13;
+    sim_random_state ^= sim_random_state >> 17;
+    sim_random_state ^= sim_random_state << 5;
+    return sim_random_state;
+}
+
+// Uniformly distributed in [base - jitter, base + jitter]
+static uint32_t sim_jittered(uint32_t base_us, uint32_t jitter_us) {
+    return base_us - jitter_us + sim_random() % (2 * jitter_us + 1);
+}
+
+// Sends the current input state unless it is what was sent last
+static void sim_send(void) {
+    const uint32_t input = (uint32_t)inputs.size();
+    if (input == sent_input) {
+        return;
+    }
+
+    xinput_report_t report = {};
+    report.report_size = sizeof(xinput_report_t);
+    report.lx = (int16_t)(input & 0xFFFF);
+    report.ly = (int16_t)(input >> 16);
+    xinput->sendReport(&report);
+    sent_input = input;
+}
+
+static void sim_latch(void) {
+    sim_send();
+}
+
+static void sim_set_time(uint32_t now_us) {
+    // yield() inside the driver may have moved the clock a little ahead
+    if ((int32_t)(now_us - micros()) > 0) {
+        mock_time_set_us(now_us);
+    }
+}
+
+// Resolves all inputs up to the one a report read at now_us carries
+static void sim_host_read(const xinput_report_t *report, uint32_t now_us, uint32_t *resolved) {
+    const uint32_t input = (uint16_t)report->lx | ((uint32_t)(uint16_t)report->ly << 16);
+    if (input <= *resolved) {
+        return;
+    }
+    for (uint32_t i = *resolved + 1; i < input; i++) {
+        inputs[i - 1].missed = true;
+    }
+    inputs[input - 1].read_us = now_us;
+    *resolved = input;
+}
+
+static void sim_run(sim_mode_t mode, uint8_t interval_ms) {
+    const uint8_t ep_in = mock_usbd_endpoint(0, TUSB_DIR_IN);
+
+    // Start every mode from a freshly configured, drained endpoint
+    mock_usbd_bus_reset();
+    mock_usbd_configure();
+    while (mock_usbd_in(ep_in, NULL, 0) >= 0) {
+    }
+    xinput->setLatchCallback(mode == SIM_LATCHED ? sim_latch : NULL);
+
+    inputs.clear();
+    sent_input = 0;
+    sim_random_state = SIM_SEED;
+
+    const uint32_t start_us = micros() + SIM_FRAME_US;
+    const uint32_t end_us = start_us + SIM_FRAMES * SIM_FRAME_US;
+    uint32_t next_input_us = start_us + sim_jittered(SIM_INPUT_PERIOD_US, SIM_INPUT_JITTER_US);
+    uint32_t next_loop_us = start_us + sim_jittered(SIM_LOOP_US, SIM_LOOP_JITTER_US);
+    uint32_t next_sof_us = start_us;
+    uint32_t next_poll_us = end_us;
+    uint32_t frame = 0;
+    uint32_t resolved = 0;
+
+    // Stop changing inputs a few polls before the end so the last ones resolve
+    const uint32_t inputs_end_us = end_us - 4 * interval_ms * SIM_FRAME_US;
+
+    while (true) {
+        const uint32_t now_us =
+            std::min(std::min(next_input_us, next_loop_us), std::min(next_sof_us, next_poll_us));
+        if (now_us >= end_us) {
+            break;
+        }
+        sim_set_time(now_us);
+
+        if (now_us == next_sof_us) {
+            mock_usbd_sof();
+            if (frame % interval_ms == 0) {
+                next_poll_us = now_us + sim_jittered(SIM_POLL_PHASE_US, SIM_POLL_JITTER_US);
+            }
+            frame++;
+            next_sof_us += SIM_FRAME_US;
+        } else if (now_us == next_poll_us) {
+            xinput_report_t report;
+            if (xinput_test_read(ep_in, &report)) {
+                sim_host_read(&report, now_us, &resolved);
+            }
+            next_poll_us = end_us;
+        } else if (now_us == next_input_us) {
+            if (now_us < inputs_end_us) {
+                inputs.push_back({ now_us, 0, false });
+            }
+            next_input_us += sim_jittered(SIM_INPUT_PERIOD_US, SIM_INPUT_JITTER_US);
+        } else {
+            if (mode == SIM_COALESCED || (mode == SIM_IMMEDIATE && xinput->ready())) {
+                sim_send();
+            }
+            next_loop_us += sim_jittered(SIM_LOOP_US, SIM_LOOP_JITTER_US);
+        }
+    }
+}
+
+static bool sim_report(sim_mode_t mode, uint8_t interval_ms, FILE *csv) {
+    std::vector<uint32_t> latencies;
+    uint32_t missed = 0;
+
+    for (size_t i = 0; i < inputs.size(); i++) {
+        const sim_input_t *input = &inputs[i];
+        if (input->read_us) {
+            latencies.push_back(input->read_us - input->event_us);
+        } else if (input->missed) {
+            missed++;
+        }
+        if (csv) {
+            fprintf(
+                csv,
+                "%s,%u,%zu,%u,",
+                sim_mode_names[mode],
+                interval_ms,
+                i + 1,
+                input->event_us
+            );
+            if (input->read_us) {
+                fprintf(csv, "%u,%u\n", input->read_us, input->read_us - input->event_us);
+            } else {
+                fprintf(csv, ",\n");
+            }
+        }
+    }
+
+    if (latencies.empty()) {
+        printf("%-10s %4u ms: no input reached the host\n", sim_mode_names[mode], interval_ms);
+        return false;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    uint64_t sum = 0;
+    for (uint32_t latency : latencies) {
+        sum += latency;
+    }
+    printf(
+        "%-10s %4u ms %8zu %8u %7.2f%% %8.1f %8u %8u %8u\n",
+        sim_mode_names[mode],
+        interval_ms,
+        inputs.size(),
+        missed,
+        100.0 * missed / inputs.size(),
+        (double)sum / latencies.size(),
+        latencies[latencies.size() / 2],
+        latencies[latencies.size() * 99 / 100],
+        latencies.back()
+    );
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const int interval_ms = argc > 1 ? atoi(argv[1]) : 1;
+    if (interval_ms < 1 || interval_ms > 255) {
+        fprintf(stderr, "usage: %s [interval_ms [csv_path]]\n", argv[0]);
+        return 2;
+    }
+
+    FILE *csv = NULL;
+    if (argc > 2) {
+        csv = fopen(argv[2], "w");
+        if (!csv) {
+            perror(argv[2]);
+            return 2;
+        }
+        fprintf(csv, "mode,interval_ms,event,event_us,read_us,latency_us\n");
+    }
+
+    xinput = new Adafruit_USBD_XInput((uint8_t)interval_ms);
+    if (!xinput->begin() || !xinput_test_attach()) {
+        return 1;
+    }
+
+    printf(
+        "%-10s %7s %8s %8s %8s %8s %8s %8s %8s\n",
+        "mode",
+        "poll",
+        "inputs",
+        "missed",
+        "missed %",
+        "mean us",
+        "p50 us",
+        "p99 us",
+        "max us"
+    );
+
+    bool ok = true;
+    for (sim_mode_t mode : { SIM_IMMEDIATE, SIM_COALESCED, SIM_LATCHED }) {
+        sim_run(mode, (uint8_t)interval_ms);
+        ok &= sim_report(mode, (uint8_t)interval_ms, csv);
+    }
+
+    if (csv) {
+        fclose(csv);
+    }
+    return ok && !mock_usbd_counters()->xfer_violations ? 0 : 1;
+}
@@ -0,0 +1,183 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// ADC filter on synthetic sample streams shaped like the RP2040 ADC output:
+// four interleaved channels with Gaussian noise and the missing-code spikes
+// around 512, 1536, 2560 and 3584. Checks noise rejection, bias, step
+// response, that chunked processing matches one pass, and that invalid
+// channel arguments are rejected rather than indexing past the channels.
+
+#include "xinput_adc.hpp"
+#include "xinput_test.hpp"
+
+#include <math.h>
+#include <stdlib.h>
+
+#define CHANNELS 4
+#define SHIFT 4
+#define NOISE_LSB 6.0
+
+static double gaussian(void) {
+    const double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    const double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+// One conversion of a true level, in 12-bit counts
+static uint16_t adc_sample(double level) {
+    long code = lround(level + gaussian() * NOISE_LSB);
+    // Differential nonlinearity: codes just below the steps are skipped
+    if ((code & 0x3FF) == 0x1FF) {
+        code += 8;
+    }
+    return (uint16_t)(code < 0 ? 0 : (code > 4095 ? 4095 : code));
+}
+
+static const double levels[CHANNELS] = { 500.0, 1536.0, 2100.0, 3600.0 };
+
+static void test_noise(void) {
+    xinput_adc_filter_t filter;
+    xinput_adc_filter_init(&filter, CHANNELS, SHIFT);
+
+    srand(5);
+    const int frames = 20000;
+    double in_sq[CHANNELS] = {}, out_sum[CHANNELS] = {}, out_sq[CHANNELS] = {};
+    for (int f = 0; f < frames; f++) {
+        uint16_t samples[CHANNELS];
+        for (int c = 0; c < CHANNELS; c++) {
+            samples[c] = adc_sample(levels[c]);
+            in_sq[c] += (samples[c] - levels[c]) * (samples[c] - levels[c]);
+        }
+        xinput_adc_filter_process(&filter, samples, CHANNELS, 0);
+
+        // Skip the start-up transient of the primed first sample
+        if (f >= 200) {
+            for (int c = 0; c < CHANNELS; c++) {
+                const double out = xinput_adc_filter_value(&filter, c) / 16.0;
+                out_sum[c] += out;
+                out_sq[c] += (out - levels[c]) * (out - levels[c]);
+            }
+        }
+    }
+
+    for (int c = 0; c < CHANNELS; c++) {
+        const double in_rms = sqrt(in_sq[c] / frames);
+        const double out_rms = sqrt(out_sq[c] / (frames - 200));
+        const double bias = out_sum[c] / (frames - 200) - levels[c];
+        printf("channel %d: noise %.2f -> %.2f LSB rms, bias %.2f LSB\n", c, in_rms, out_rms, bias);
+
+        // An EMA with alpha 1/16 keeps sqrt(alpha / (2 - alpha)) = 0.18 of
+        // white noise
+        XINPUT_CHECK(out_rms < in_rms * 0.25);
+        XINPUT_CHECK(fabs(bias) < 1.0);
+    }
+}
+
+static void test_step(void) {
+    xinput_adc_filter_t filter;
+    xinput_adc_filter_init(&filter, CHANNELS, SHIFT);
+
+    // The first sample primes the output, no ramp up from zero
+    const uint16_t first[CHANNELS] = { 1000, 1000, 1000, 1000 };
+    xinput_adc_filter_process(&filter, first, CHANNELS, 0);
+    XINPUT_CHECK_EQ(xinput_adc_filter_value(&filter, 0), 1000 << 4);
+
+    // Step on channel 2 only: within 1% after ln(100) * 16 = 74 samples
+    int settled = -1;
+    for (int n = 1; n <= 200 && settled < 0; n++) {
+        const uint16_t samples[CHANNELS] = { 1000, 1000, 3000, 1000 };
+        xinput_adc_filter_process(&filter, samples, CHANNELS, 0);
+        if (xinput_adc_filter_value(&filter, 2) >= (3000 - 20) << 4) {
+            settled = n;
+        }
+        XINPUT_CHECK_EQ(xinput_adc_filter_value(&filter, 1), 1000 << 4);
+    }
+    XINPUT_CHECK(settled >= 70 && settled <= 76);
+
+    // Only the 12 data bits count, the FIFO error flag is ignored
+    xinput_adc_filter_init(&filter, 1, 16);
+    const uint16_t flagged = 0x8000 | 4095;
+    for (int n = 0; n < 1000; n++) {
+        xinput_adc_filter_process(&filter, &flagged, 1, 0);
+    }
+    XINPUT_CHECK_EQ(xinput_adc_filter_value(&filter, 0), 4095 << 4);
+}
+
+// The DMA ring is consumed in pieces of any length starting at any channel
+static void test_chunks(void) {
+    static uint16_t stream[CHANNELS * 1000];
+    srand(6);
+    for (uint32_t i = 0; i < sizeof(stream) / sizeof(stream[0]); i++) {
+        stream[i] = adc_sample(levels[i % CHANNELS]);
+    }
+
+    xinput_adc_filter_t whole, chunked;
+    xinput_adc_filter_init(&whole, CHANNELS, SHIFT);
+    xinput_adc_filter_init(&chunked, CHANNELS, SHIFT);
+    xinput_adc_filter_process(&whole, stream, CHANNELS * 1000, 0);
+
+    uint32_t pos = 0;
+    while (pos < CHANNELS * 1000) {
+        uint32_t count = (uint32_t)(rand() % 37);
+        count = count < CHANNELS * 1000 - pos ? count : CHANNELS * 1000 - pos;
+        xinput_adc_filter_process(&chunked, stream + pos, count, pos % CHANNELS);
+        pos += count;
+    }
+    XINPUT_CHECK(memcmp(whole.acc, chunked.acc, sizeof(whole.acc)) == 0);
+}
+
+static void test_invalid(void) {
+    // Guard words around the filter catch writes past its channels
+    struct {
+        xinput_adc_filter_t filter;
+        uint32_t guard[8];
+    } guarded;
+    memset(&guarded, 0xA5, sizeof(guarded));
+    const uint16_t samples[8] = { 100, 200, 300, 400, 500, 600, 700, 800 };
+
+    XINPUT_CHECK(!xinput_adc_filter_init(&guarded.filter, 0, SHIFT));
+    xinput_adc_filter_process(&guarded.filter, samples, 8, 0);
+    XINPUT_CHECK(!xinput_adc_filter_init(&guarded.filter, XINPUT_ADC_MAX_CHANNELS + 1, SHIFT));
+    xinput_adc_filter_process(&guarded.filter, samples, 8, 0);
+    XINPUT_CHECK_EQ(guarded.filter.primed, 0);
+
+    XINPUT_CHECK(xinput_adc_filter_init(&guarded.filter, 2, SHIFT));
+    xinput_adc_filter_process(&guarded.filter, samples, 8, 2);
+    xinput_adc_filter_process(&guarded.filter, samples, 8, 200);
+    XINPUT_CHECK_EQ(guarded.filter.primed, 0);
+    xinput_adc_filter_process(&guarded.filter, samples, 8, 1);
+    XINPUT_CHECK_EQ(guarded.filter.primed, 3);
+
+    for (uint32_t word : guarded.guard) {
+        XINPUT_CHECK_EQ(word, 0xA5A5A5A5);
+    }
+}
+
+int main(void) {
+    test_noise();
+    test_step();
+    test_chunks();
+    test_invalid();
+    return xinput_test_result();
+}
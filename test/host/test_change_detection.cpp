@@ -0,0 +1,118 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Change detection and keepalive against the mock device stack: unchanged
+// reports are suppressed and counted, a change always goes out, and the
+// keepalive resends an unchanged report only when the application keeps
+// sending it.
+
+#include "xinput_test.hpp"
+
+static Adafruit_USBD_XInput xinput;
+
+static uint8_t ep_in;
+
+static xinput_report_t make_report(int16_t lx) {
+    xinput_report_t report = {};
+    report.report_size = sizeof(xinput_report_t);
+    report.lx = lx;
+    return report;
+}
+
+static void test_suppression(void) {
+    const xinput_report_t a = make_report(1), b = make_report(2);
+    xinput_report_t read;
+    xinput.setChangeDetection(true);
+
+    XINPUT_CHECK(xinput.sendReport(&a));
+    XINPUT_CHECK(xinput_test_read(ep_in, &read));
+    XINPUT_CHECK_EQ(xinput.reportsQueued(), 1);
+
+    // Suppressed calls still succeed, nothing reaches the endpoint
+    for (int i = 0; i < 5; i++) {
+        mock_time_advance_us(1000);
+        XINPUT_CHECK(xinput.sendReport(&a));
+    }
+    XINPUT_CHECK(!xinput_test_read(ep_in, &read));
+    XINPUT_CHECK_EQ(xinput.reportsQueued(), 1);
+    XINPUT_CHECK_EQ(xinput.reportsSuppressed(), 5);
+
+    XINPUT_CHECK(xinput.sendReport(&b));
+    XINPUT_CHECK(xinput_test_read(ep_in, &read));
+    XINPUT_CHECK_EQ(read.lx, 2);
+    XINPUT_CHECK_EQ(xinput.reportsQueued(), 2);
+
+    // publishReport() is filtered the same way
+    XINPUT_CHECK(xinput.publishReport(&b));
+    mock_usbd_sof();
+    XINPUT_CHECK(!xinput_test_read(ep_in, &read));
+    XINPUT_CHECK_EQ(xinput.reportsSuppressed(), 6);
+}
+
+static void test_keepalive(void) {
+    const xinput_report_t c = make_report(3);
+    xinput_report_t read;
+    xinput.setChangeDetection(true, 100);
+
+    mock_time_set_us(1000000);
+    XINPUT_CHECK(xinput.sendReport(&c));
+    XINPUT_CHECK(xinput_test_read(ep_in, &read));
+
+    mock_time_set_us(1099000);
+    XINPUT_CHECK(xinput.sendReport(&c));
+    XINPUT_CHECK(!xinput_test_read(ep_in, &read));
+
+    // keepalive_ms after the last queued report the same report goes out
+    mock_time_set_us(1100000);
+    XINPUT_CHECK(xinput.sendReport(&c));
+    XINPUT_CHECK(xinput_test_read(ep_in, &read));
+    XINPUT_CHECK_EQ(read.lx, 3);
+
+    // The driver never resends on its own
+    for (int i = 0; i < 500; i++) {
+        mock_time_advance_us(1000);
+        mock_usbd_sof();
+        XINPUT_CHECK(!xinput_test_read(ep_in, &read));
+    }
+
+    // Disabled, every report is queued again
+    const uint32_t queued = xinput.reportsQueued();
+    xinput.setChangeDetection(false);
+    XINPUT_CHECK(xinput.sendReport(&c));
+    XINPUT_CHECK(xinput.sendReport(&c));
+    XINPUT_CHECK_EQ(xinput.reportsQueued(), queued + 2);
+    while (xinput_test_read(ep_in, &read)) {
+    }
+}
+
+int main(void) {
+    XINPUT_CHECK(xinput.begin());
+    XINPUT_CHECK(xinput_test_attach());
+    ep_in = mock_usbd_endpoint(0, TUSB_DIR_IN);
+
+    test_suppression();
+    test_keepalive();
+
+    return xinput_test_result();
+}
@@ -0,0 +1,165 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Stick and trigger conditioning against a floating point reference, plus
+// the properties a controller relies on: rest reads zero, full deflection
+// reads full scale and output never goes backwards as the input increases.
+
+#include "xinput_conditioning.hpp"
+#include "xinput_test.hpp"
+
+#include <math.h>
+
+static constexpr xinput_curve_t curve_linear = xinput_curve_expo(0);
+static constexpr xinput_curve_t curve_cubic = xinput_curve_expo(255);
+
+static const xinput_axis_cal_t cal_x = { 100, 2048, 4000, false };
+static const xinput_axis_cal_t cal_y = { 0, 2000, 4095, true };
+
+// Deadzone and anti-deadzone on a Q15 magnitude in floating point
+static double reference_response(double magnitude, double deadzone, double anti_deadzone) {
+    if (magnitude <= deadzone) {
+        return 0;
+    }
+    return anti_deadzone + (magnitude - deadzone) * (32767 - anti_deadzone) / (32767 - deadzone);
+}
+
+static double reference_axis(const xinput_axis_cal_t *cal, uint16_t raw) {
+    double value = (double)raw - cal->center;
+    value = cal->invert ? -value : value;
+    const bool below_center = (value < 0) != cal->invert;
+    const double span = below_center ? cal->center - cal->min : cal->max - cal->center;
+    return fmax(-32767, fmin(32767, value * 32767 / span));
+}
+
+static void test_curves(void) {
+    for (int i = 0; i <= XINPUT_CURVE_SEGMENTS; i++) {
+        const int x = i == XINPUT_CURVE_SEGMENTS ? 32767 : i << XINPUT_CURVE_SHIFT;
+        XINPUT_CHECK_EQ(curve_linear.points[i], x);
+    }
+    XINPUT_CHECK_EQ(curve_cubic.points[XINPUT_CURVE_SEGMENTS / 2], 4096);
+    XINPUT_CHECK_EQ(curve_cubic.points[XINPUT_CURVE_SEGMENTS], 32767);
+}
+
+static void test_stick_axial(void) {
+    const xinput_stick_config_t config = { cal_x, cal_y, 2000, 1000, false, NULL };
+    xinput_stick_t stick;
+    xinput_stick_init(&stick, &config);
+
+    int16_t x, y;
+    xinput_stick_process(&stick, cal_x.center, cal_y.center, &x, &y);
+    XINPUT_CHECK_EQ(x, 0);
+    XINPUT_CHECK_EQ(y, 0);
+    xinput_stick_process(&stick, cal_x.max, cal_y.max, &x, &y);
+    XINPUT_CHECK(x >= 32760);
+    XINPUT_CHECK(y <= -32760);
+    xinput_stick_process(&stick, cal_x.min, cal_y.min, &x, &y);
+    XINPUT_CHECK(x <= -32760);
+    XINPUT_CHECK(y >= 32760);
+
+    // Beyond the calibrated range saturates instead of wrapping
+    xinput_stick_process(&stick, 0, 0, &x, &y);
+    XINPUT_CHECK(x <= -32760);
+
+    int max_error = 0;
+    int16_t previous = INT16_MIN;
+    for (uint16_t raw = 0; raw < 4096; raw++) {
+        xinput_stick_process(&stick, raw, cal_y.center, &x, &y);
+        const double in = reference_axis(&cal_x, raw);
+        const double out = reference_response(fabs(in), 2000, 1000);
+        const int error = abs(x - (int)lround(in < 0 ? -out : out));
+        max_error = error > max_error ? error : max_error;
+        XINPUT_CHECK(x >= previous);
+        XINPUT_CHECK_EQ(y, 0);
+        previous = x;
+    }
+    XINPUT_CHECK(max_error <= 4);
+}
+
+static void test_stick_radial(void) {
+    const xinput_stick_config_t config = { cal_x, cal_x, 3000, 0, true, &curve_linear };
+    xinput_stick_t stick;
+    xinput_stick_init(&stick, &config);
+
+    // Along the diagonal each axis alone is inside the deadzone but the
+    // magnitude is past it, so the stick moves without snapping to an axis
+    int16_t x, y;
+    xinput_stick_process(&stick, cal_x.center + 150, cal_x.center + 150, &x, &y);
+    XINPUT_CHECK(x > 0);
+    XINPUT_CHECK_EQ(x, y);
+    xinput_stick_process(&stick, cal_x.center + 100, cal_x.center + 100, &x, &y);
+    XINPUT_CHECK_EQ(x, 0);
+    XINPUT_CHECK_EQ(y, 0);
+
+    // Square gate corners saturate on the unit circle and keep the direction
+    xinput_stick_process(&stick, cal_x.max, cal_x.max, &x, &y);
+    const double magnitude = sqrt((double)x * x + (double)y * y);
+    XINPUT_CHECK(magnitude <= 32767.5 && magnitude >= 32700);
+    XINPUT_CHECK(abs(x - y) <= 1);
+
+    // Magnitude follows the reference response along any direction
+    int max_error = 0;
+    for (int angle = 0; angle < 360; angle += 15) {
+        for (int r = 0; r <= 1900; r += 50) {
+            const double rad = angle * M_PI / 180;
+            const uint16_t raw_x = (uint16_t)lround(cal_x.center + r * cos(rad));
+            const uint16_t raw_y = (uint16_t)lround(cal_x.center + r * sin(rad));
+            xinput_stick_process(&stick, raw_x, raw_y, &x, &y);
+
+            const double in_x = reference_axis(&cal_x, raw_x);
+            const double in_y = reference_axis(&cal_x, raw_y);
+            const double in = fmin(32767, sqrt(in_x * in_x + in_y * in_y));
+            const double out = reference_response(in, 3000, 0);
+            const int error = (int)fabs(sqrt((double)x * x + (double)y * y) - out);
+            max_error = error > max_error ? error : max_error;
+        }
+    }
+    XINPUT_CHECK(max_error <= 16);
+}
+
+static void test_trigger(void) {
+    const xinput_trigger_config_t config = { 3500, 500, 1000, 0, &curve_cubic };
+    xinput_trigger_t trigger;
+    xinput_trigger_init(&trigger, &config);
+
+    XINPUT_CHECK_EQ(xinput_trigger_process(&trigger, 4095), 0);
+    XINPUT_CHECK_EQ(xinput_trigger_process(&trigger, 3500), 0);
+    XINPUT_CHECK_EQ(xinput_trigger_process(&trigger, 500), 255);
+    XINPUT_CHECK_EQ(xinput_trigger_process(&trigger, 0), 255);
+
+    uint8_t previous = 0;
+    for (int raw = 4095; raw >= 0; raw--) {
+        const uint8_t value = xinput_trigger_process(&trigger, (uint16_t)raw);
+        XINPUT_CHECK(value >= previous);
+        previous = value;
+    }
+}
+
+int main(void) {
+    test_curves();
+    test_stick_axial();
+    test_stick_radial();
+    test_trigger();
+    return xinput_test_result();
+}
@@ -0,0 +1,148 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Vendor control requests during enumeration, replayed in the order Windows
+// and the XUSB driver issue them for two controllers: every request has to be
+// answered on its first round trip with the right data, unknown requests
+// stall, and statistics land on the instance the request addresses.
+
+#include "xinput_descriptors.hpp"
+#include "xinput_test.hpp"
+
+static Adafruit_USBD_XInput xinput[2];
+
+static void test_ms_os_20(void) {
+    // The BOS descriptor announces the set length and vendor code
+    const uint8_t *bos = tud_descriptor_bos_cb();
+    const uint16_t set_len = tu_u16(
+        bos[XINPUT_BOS_MS_OS_20_LEN_OFFSET + 1],
+        bos[XINPUT_BOS_MS_OS_20_LEN_OFFSET]
+    );
+    const uint8_t vendor_code = bos[XINPUT_BOS_MS_OS_20_LEN_OFFSET + 2];
+    XINPUT_CHECK_EQ(set_len, XINPUT_MS_OS_20_DESC_LEN(2));
+
+    uint8_t set[512];
+    uint16_t len;
+    const tusb_control_request_t request = xinput_test_request(0xC0, vendor_code, 0, 7, set_len);
+    XINPUT_CHECK(mock_usbd_control(&request, set, &len));
+    XINPUT_CHECK_EQ(len, set_len);
+    XINPUT_CHECK_EQ(tu_u16(set[9], set[8]), set_len);
+
+    // One function subset per controller, bound to its interface
+    const uint8_t *function = set + XINPUT_MS_OS_20_HEADER_LEN;
+    for (uint8_t i = 0; i < 2; i++) {
+        XINPUT_CHECK_EQ(function[2], MS_OS_20_SUBSET_HEADER_FUNCTION);
+        XINPUT_CHECK_EQ(function[XINPUT_MS_OS_20_FUNCTION_ITFNUM_OFFSET], i);
+        XINPUT_CHECK(memcmp(function + XINPUT_MS_OS_20_FUNCTION_HEADER_LEN + 4, "XUSB20", 6) == 0);
+        function += XINPUT_MS_OS_20_FUNCTION_LEN;
+    }
+
+    // A short wLength gets the start of the set
+    const tusb_control_request_t header = xinput_test_request(0xC0, vendor_code, 0, 7, 10);
+    XINPUT_CHECK(mock_usbd_control(&header, set, &len));
+    XINPUT_CHECK_EQ(len, 10);
+}
+
+static void test_enumeration(void) {
+    struct {
+        tusb_control_request_t request;
+        uint16_t length; // expected data stage, 0 for a stall
+    } sequence[] = {
+        { xinput_test_request(0xC0, 0x01, 0x0000, 0x0000, 4), 4 },   // serial number
+        { xinput_test_request(0xC1, 0x01, 0x0100, 0x0000, 20), 20 }, // input capabilities
+        { xinput_test_request(0xC1, 0x01, 0x0000, 0x0000, 8), 8 },   // output capabilities
+        { xinput_test_request(0xC1, 0x01, 0x0100, 0x0001, 20), 20 },
+        { xinput_test_request(0xC1, 0x01, 0x0000, 0x0001, 8), 8 },
+    };
+
+    mock_usbd_clear_counters();
+    uint8_t data[64];
+    for (const auto &step : sequence) {
+        uint16_t len;
+        XINPUT_CHECK(mock_usbd_control(&step.request, data, &len));
+        XINPUT_CHECK_EQ(len, step.length);
+    }
+    XINPUT_CHECK_EQ(mock_usbd_counters()->control_answered, 5);
+    XINPUT_CHECK_EQ(mock_usbd_counters()->control_stalled, 0);
+
+    // Both rumble motors are reported as supported
+    const tusb_control_request_t output = xinput_test_request(0xC1, 0x01, 0x0000, 0x0001, 8);
+    XINPUT_CHECK(mock_usbd_control(&output, data, NULL));
+    XINPUT_CHECK_EQ(data[1], 8);
+    XINPUT_CHECK_EQ(data[3], 0xFF);
+    XINPUT_CHECK_EQ(data[4], 0xFF);
+
+    // Requests the driver does not know still stall
+    const tusb_control_request_t unknown[] = {
+        xinput_test_request(0xC1, 0x01, 0x0200, 0x0000, 8),
+        xinput_test_request(0xC0, 0x02, 0x0000, 0x0000, 8),
+        xinput_test_request(0xC0, 0x01, 0x0000, 0x0004, 16),
+    };
+    for (const auto &request : unknown) {
+        XINPUT_CHECK(!mock_usbd_control(&request, data, NULL));
+    }
+}
+
+static void test_stats(void) {
+    for (auto &dev : xinput) {
+        dev.resetStats();
+    }
+
+    const tusb_control_request_t itf0 = xinput_test_request(0xC1, 0x01, 0x0000, 0x0000, 8);
+    const tusb_control_request_t itf1 = xinput_test_request(0xC1, 0x01, 0x0000, 0x0001, 8);
+    const tusb_control_request_t itf1_unknown = xinput_test_request(0xC1, 0x01, 0x0300, 1, 8);
+    const tusb_control_request_t device = xinput_test_request(0xC0, 0x01, 0x0000, 0x0000, 4);
+    mock_usbd_control(&itf0, NULL, NULL);
+    mock_usbd_control(&itf1, NULL, NULL);
+    mock_usbd_control(&itf1, NULL, NULL);
+    mock_usbd_control(&itf1_unknown, NULL, NULL);
+    mock_usbd_control(&device, NULL, NULL);
+
+    xinput_stats_t stats[2];
+    xinput[0].getStats(&stats[0]);
+    xinput[1].getStats(&stats[1]);
+    XINPUT_CHECK_EQ(stats[0].control_answered, 2);
+    XINPUT_CHECK_EQ(stats[0].control_stalled, 0);
+    XINPUT_CHECK_EQ(stats[1].control_answered, 2);
+    XINPUT_CHECK_EQ(stats[1].control_stalled, 1);
+}
+
+int main(void) {
+    XINPUT_CHECK(xinput[0].begin());
+    XINPUT_CHECK(xinput[1].begin());
+    XINPUT_CHECK(xinput_test_attach());
+
+    test_ms_os_20();
+    test_enumeration();
+    test_stats();
+
+    // Enumeration done, both controllers take reports right away and send
+    // nothing the application did not publish
+    for (uint8_t i = 0; i < 2; i++) {
+        xinput_report_t report;
+        XINPUT_CHECK(!xinput_test_read(mock_usbd_endpoint(i, TUSB_DIR_IN), &report));
+        XINPUT_CHECK(xinput[i].ready());
+    }
+    return xinput_test_result();
+}
@@ -0,0 +1,192 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// HID to XInput translation on reports in the layout of a DualShock 4 over
+// USB, and the latency forwarding adds: frames between a HID report arriving
+// from the host port and the PC reading the translated XInput report.
+
+#include "xinput_hid_adapter.hpp"
+#include "xinput_report.hpp"
+#include "xinput_test.hpp"
+
+#include <stdlib.h>
+
+static Adafruit_USBD_XInput xinput;
+
+// Report ID 1, then LX LY RX RY, hat and face buttons, shoulder and stick
+// buttons, PS button, L2 and R2
+static const xinput_hid_map_t ds4_map = {
+    0x01,
+    {
+        { XINPUT_HID_NONE, 0 }, { XINPUT_HID_NONE, 0 }, // D-pad from the hat
+        { XINPUT_HID_NONE, 0 }, { XINPUT_HID_NONE, 0 },
+        { 5, 0x20 }, // options -> start
+        { 5, 0x10 }, // share -> back
+        { 5, 0x40 }, // L3
+        { 5, 0x80 }, // R3
+        { 5, 0x01 }, // L1
+        { 5, 0x02 }, // R1
+        { 6, 0x01 }, // PS -> home
+        { XINPUT_HID_NONE, 0 },
+        { 4, 0x20 }, // cross -> A
+        { 4, 0x40 }, // circle -> B
+        { 4, 0x10 }, // square -> X
+        { 4, 0x80 }, // triangle -> Y
+    },
+    4,
+    { 0, XINPUT_HID_AXIS_U8 },
+    { 1, XINPUT_HID_AXIS_U8 | XINPUT_HID_AXIS_INVERT },
+    { 2, XINPUT_HID_AXIS_U8 },
+    { 3, XINPUT_HID_AXIS_U8 | XINPUT_HID_AXIS_INVERT },
+    { 7, XINPUT_HID_AXIS_U8 },
+    { 8, XINPUT_HID_AXIS_U8 },
+};
+
+#define DS4_REPORT_LEN 64
+
+static void ds4_report(uint8_t *hid, uint8_t lx, uint8_t ly, uint8_t hat, uint8_t face) {
+    memset(hid, 0, DS4_REPORT_LEN);
+    hid[0] = 0x01;
+    hid[1] = lx;
+    hid[2] = ly;
+    hid[3] = 0x80;
+    hid[4] = 0x80;
+    hid[5] = (uint8_t)(hat | face);
+}
+
+static void test_translate(void) {
+    uint8_t hid[DS4_REPORT_LEN];
+    xinput_report_t report;
+
+    // At rest: sticks centered, hat released (8)
+    ds4_report(hid, 0x80, 0x80, 0x08, 0);
+    XINPUT_CHECK(xinput_hid_translate(&ds4_map, hid, sizeof(hid), &report));
+    XINPUT_CHECK_EQ(xinput_report_get_buttons(&report), 0);
+    XINPUT_CHECK_EQ(report.lx, 0);
+    XINPUT_CHECK_EQ(report.ly, 0);
+    XINPUT_CHECK_EQ(report.report_size, sizeof(xinput_report_t));
+
+    // Full left and up; HID Y grows downwards, XInput Y upwards
+    ds4_report(hid, 0x00, 0x00, 0x08, 0);
+    XINPUT_CHECK(xinput_hid_translate(&ds4_map, hid, sizeof(hid), &report));
+    XINPUT_CHECK_EQ(report.lx, -32768);
+    XINPUT_CHECK_EQ(report.ly, 32767);
+    ds4_report(hid, 0xFF, 0xFF, 0x08, 0);
+    XINPUT_CHECK(xinput_hid_translate(&ds4_map, hid, sizeof(hid), &report));
+    XINPUT_CHECK_EQ(report.lx, 32512);
+    XINPUT_CHECK_EQ(report.ly, -32512);
+
+    // Hat diagonal and face buttons
+    ds4_report(hid, 0x80, 0x80, 0x03, 0x20 | 0x80);
+    hid[6] = 0x01 | 0x20; // L1, options
+    hid[7] = 0x01;        // PS
+    hid[8] = 0xFF;        // L2 fully pressed
+    XINPUT_CHECK(xinput_hid_translate(&ds4_map, hid, sizeof(hid), &report));
+    XINPUT_CHECK_EQ(
+        xinput_report_get_buttons(&report),
+        XINPUT_BUTTON_DPAD_DOWN | XINPUT_BUTTON_DPAD_RIGHT | XINPUT_BUTTON_A | XINPUT_BUTTON_Y |
+            XINPUT_BUTTON_LB | XINPUT_BUTTON_START | XINPUT_BUTTON_HOME
+    );
+    XINPUT_CHECK_EQ(report.lt, 255);
+    XINPUT_CHECK_EQ(report.rt, 0);
+
+    // Other report IDs and short reports are rejected
+    hid[0] = 0x11;
+    XINPUT_CHECK(!xinput_hid_translate(&ds4_map, hid, sizeof(hid), &report));
+    hid[0] = 0x01;
+    XINPUT_CHECK(!xinput_hid_translate(&ds4_map, hid, 9, &report));
+    XINPUT_CHECK(xinput_hid_translate(&ds4_map, hid, 10, &report));
+}
+
+// The pad reports every 4 ms, the PC polls once per 1 ms frame. A report
+// arrives either before or after the poll of its frame. Returns the number of
+// frames from a report arriving to the PC reading it, worst case and mean.
+static uint32_t forward_latency(uint8_t ep_in, bool flush, double *mean) {
+    uint8_t hid[DS4_REPORT_LEN];
+    uint32_t arrival_frame[256] = {};
+    uint32_t worst = 0, total = 0, delivered = 0;
+
+    srand(7);
+    for (uint32_t frame = 0; frame < 40000; frame++) {
+        const bool due = frame % 4 == 0;
+        const bool before_poll = rand() % 2;
+        const uint8_t lx = (uint8_t)(frame / 4);
+
+        mock_usbd_sof();
+        for (int step = 0; step < 2; step++) {
+            if (due && before_poll == (step == 0)) {
+                ds4_report(hid, lx, 0x80, 0x08, 0);
+                XINPUT_CHECK(xinput_hid_forward(&xinput, &ds4_map, hid, sizeof(hid)));
+                arrival_frame[lx] = frame;
+                if (flush) {
+                    xinput.flush();
+                }
+            } else {
+                xinput_report_t read;
+                if (xinput_test_read(ep_in, &read)) {
+                    const uint8_t seen = (uint8_t)((read.lx >> 8) + 128);
+                    const uint32_t latency = frame - arrival_frame[seen];
+                    worst = latency > worst ? latency : worst;
+                    total += latency;
+                    delivered++;
+                }
+            }
+        }
+    }
+
+    // Every report reached the PC
+    XINPUT_CHECK_EQ(delivered, 40000 / 4);
+    *mean = (double)total / delivered;
+    return worst;
+}
+
+int main(void) {
+    test_translate();
+
+    XINPUT_CHECK(xinput.begin());
+    XINPUT_CHECK(xinput_test_attach());
+    const uint8_t ep_in = mock_usbd_endpoint(0, TUSB_DIR_IN);
+    xinput_report_t read;
+    xinput_test_read(ep_in, &read);
+
+    // Published only: picked up on the next SOF, so always read in the next
+    // frame. Flushed by the same core: read in the same frame when the PC
+    // polls after the arrival.
+    double published_mean, flushed_mean;
+    const uint32_t published = forward_latency(ep_in, false, &published_mean);
+    const uint32_t flushed = forward_latency(ep_in, true, &flushed_mean);
+    printf(
+        "added latency in frames: published worst %u mean %.2f, flushed worst %u mean %.2f\n",
+        published,
+        published_mean,
+        flushed,
+        flushed_mean
+    );
+    XINPUT_CHECK_EQ(published, 1);
+    XINPUT_CHECK_EQ(flushed, 1);
+    XINPUT_CHECK(flushed_mean > 0.4 && flushed_mean < 0.6);
+
+    XINPUT_CHECK_EQ(mock_usbd_counters()->xfer_violations, 0);
+    return xinput_test_result();
+}
@@ -0,0 +1,144 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// SOF latch and frame phase against the mock device stack. The host polls
+// the IN endpoint of a 4 ms controller 600 us into every fourth frame; the
+// latch must learn that frame, run in it (or earlier when the lead reaches
+// back past SOF) and framePhase() must settle on the poll phase. A second
+// controller is constructed with the invalid interval 0.
+
+#include "xinput_test.hpp"
+
+#define POLL_PHASE_US 600
+#define POLL_FRAME 2 // frames where frame % 4 == POLL_FRAME are polled
+
+static Adafruit_USBD_XInput xinput(4);
+static Adafruit_USBD_XInput xinput_zero(0);
+
+static uint32_t frame;
+static uint32_t latches;
+static uint32_t latch_frames[4]; // latch count per frame % 4
+static uint32_t zero_latches;
+
+static void on_latch(void) {
+    latches++;
+    latch_frames[frame % 4]++;
+
+    xinput_report_t report = {};
+    report.report_size = sizeof(xinput_report_t);
+    report.lx = (int16_t)frame;
+    xinput.sendReport(&report);
+}
+
+static void on_zero_latch(void) {
+    zero_latches++;
+}
+
+// Plays count frames, returns the number of reports the 4 ms host read
+static uint32_t run_frames(uint32_t count) {
+    const uint8_t ep_in = mock_usbd_endpoint(0, TUSB_DIR_IN);
+    const uint8_t ep_zero = mock_usbd_endpoint(1, TUSB_DIR_IN);
+    uint32_t reads = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        frame++;
+        mock_time_set_us(frame * 1000);
+        mock_usbd_sof();
+
+        mock_time_set_us(frame * 1000 + POLL_PHASE_US);
+        xinput_report_t report;
+        if (frame % 4 == POLL_FRAME && xinput_test_read(ep_in, &report)) {
+            reads++;
+        }
+        mock_usbd_in(ep_zero, NULL, 0);
+    }
+    return reads;
+}
+
+static void clear_latches(void) {
+    latches = 0;
+    memset(latch_frames, 0, sizeof(latch_frames));
+}
+
+static void test_phase(void) {
+    xinput.setLatchCallback(on_latch, 100);
+    run_frames(400);
+
+    // The IIR filter settles within its resolution of 8 us
+    XINPUT_CHECK(xinput.framePhase() > POLL_PHASE_US - 8);
+    XINPUT_CHECK(xinput.framePhase() <= POLL_PHASE_US);
+}
+
+static void test_poll_frame(void) {
+    // Once per interval, in the polled frame, and each latched report is read
+    clear_latches();
+    const uint32_t reads = run_frames(40);
+    XINPUT_CHECK_EQ(latches, 10);
+    XINPUT_CHECK_EQ(latch_frames[POLL_FRAME], 10);
+    XINPUT_CHECK_EQ(reads, 10);
+}
+
+static void test_lead_past_sof(void) {
+    // A lead longer than the phase latches in the frame before the poll
+    xinput.setLatchCallback(on_latch, POLL_PHASE_US + 100);
+    clear_latches();
+    const uint32_t reads = run_frames(40);
+    XINPUT_CHECK_EQ(latches, 10);
+    XINPUT_CHECK_EQ(latch_frames[(POLL_FRAME + 3) % 4], 10);
+    XINPUT_CHECK_EQ(reads, 10);
+
+    xinput.setLatchCallback(NULL);
+    clear_latches();
+    run_frames(8);
+    XINPUT_CHECK_EQ(latches, 0);
+}
+
+static void test_zero_interval(void) {
+    // Taken as 1 ms, both in the descriptor and by the latch
+    uint8_t desc[TUD_XINPUT_DESC_LEN];
+    XINPUT_CHECK_EQ(xinput_zero.getInterfaceDescriptor(1, desc, sizeof(desc)), sizeof(desc));
+    XINPUT_CHECK_EQ(desc[9 + 16 + 6], 1); // bInterval of the IN endpoint
+
+    xinput_zero.setLatchCallback(on_zero_latch);
+    xinput_report_t report = {};
+    report.report_size = sizeof(xinput_report_t);
+    xinput_zero.sendReport(&report);
+    run_frames(8);
+    XINPUT_CHECK_EQ(zero_latches, 8);
+    xinput_zero.setLatchCallback(NULL);
+}
+
+int main(void) {
+    XINPUT_CHECK(xinput.begin());
+    XINPUT_CHECK(xinput_zero.begin());
+    XINPUT_CHECK(xinput_test_attach());
+
+    test_phase();
+    test_poll_frame();
+    test_lead_past_sof();
+    test_zero_interval();
+
+    XINPUT_CHECK_EQ(mock_usbd_counters()->xfer_violations, 0);
+    return xinput_test_result();
+}
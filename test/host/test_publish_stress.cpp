@@ -0,0 +1,134 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Two-thread stress test for publishReport(): a producer thread stands in for
+// core1 and publishes numbered reports as fast as it can, while the main
+// thread plays the USB task and the host, delivering SOFs and reading the IN
+// endpoint. Every report the host reads must be one the producer published,
+// complete and not mixed with another, and sequence numbers must only grow.
+
+#include "xinput_test.hpp"
+
+#include <atomic>
+#include <thread>
+
+// Wall time to run for. Threads yield now and then so the run interleaves
+// them often even on a single CPU, preemption lands anywhere in between.
+#define STRESS_MS 1000
+#define STRESS_MIN_READS 10000
+
+static Adafruit_USBD_XInput xinput;
+
+// Every payload byte depends on the sequence number, so a report assembled
+// from two publishes does not match the pattern of either
+static void stress_fill(xinput_report_t *report, uint32_t seq) {
+    uint8_t *bytes = (uint8_t *)report;
+    bytes[0] = 0;
+    bytes[1] = sizeof(xinput_report_t);
+    for (uint8_t k = 2; k < sizeof(xinput_report_t); k++) {
+        bytes[k] = (uint8_t)((seq >> (8 * (k & 3))) + k);
+    }
+}
+
+static uint32_t stress_seq(const xinput_report_t *report) {
+    const uint8_t *bytes = (const uint8_t *)report;
+    uint32_t seq = 0;
+    for (uint8_t j = 0; j < 4; j++) {
+        seq |= (uint32_t)(uint8_t)(bytes[4 + j] - (4 + j)) << (8 * j);
+    }
+    return seq;
+}
+
+int main(void) {
+    XINPUT_CHECK(xinput.begin());
+    XINPUT_CHECK(xinput_test_attach());
+    const uint8_t ep_in = mock_usbd_endpoint(0, TUSB_DIR_IN);
+
+    // Nothing was published yet, so nothing is sent on open
+    xinput_report_t read;
+    XINPUT_CHECK(!xinput_test_read(ep_in, &read));
+
+    std::atomic<bool> stop(false);
+    std::atomic<uint32_t> published(0);
+    std::thread producer([&]() {
+        xinput_report_t report;
+        uint32_t seq = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+            stress_fill(&report, ++seq);
+            xinput.publishReport(&report);
+            if ((seq & 15) == 0) {
+                std::this_thread::yield();
+            }
+        }
+        published.store(seq, std::memory_order_release);
+    });
+
+    uint32_t reads = 0, torn = 0, reordered = 0;
+    uint32_t last_seq = 0;
+    const auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(STRESS_MS);
+    for (uint32_t frame = 0;; frame++) {
+        // One poll per frame. Alternate between pickup on SOF and on IN
+        // completion.
+        if (frame & 1) {
+            mock_usbd_sof();
+        }
+        const bool idle = !xinput_test_read(ep_in, &read);
+        if (!idle) {
+            xinput_report_t expected;
+            const uint32_t seq = stress_seq(&read);
+            stress_fill(&expected, seq);
+            torn += memcmp(&read, &expected, sizeof(xinput_report_t)) != 0;
+            reordered += seq <= last_seq;
+            last_seq = seq;
+            reads++;
+        }
+
+        if (stop.load(std::memory_order_relaxed)) {
+            if (published.load(std::memory_order_acquire) && !mock_usbd_armed(ep_in)) {
+                break;
+            }
+        } else if (std::chrono::steady_clock::now() >= end) {
+            stop.store(true, std::memory_order_relaxed);
+        }
+        if (idle) {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+
+    // The newest report must still reach the host once the producer stops
+    mock_usbd_sof();
+    while (xinput_test_read(ep_in, &read)) {
+        last_seq = stress_seq(&read);
+        reads++;
+    }
+
+    printf("%u reports published, %u read by the host\n", published.load(), reads);
+    XINPUT_CHECK_EQ(torn, 0);
+    XINPUT_CHECK_EQ(reordered, 0);
+    XINPUT_CHECK_EQ(last_seq, published.load());
+    XINPUT_CHECK(reads >= STRESS_MIN_READS);
+    XINPUT_CHECK_EQ(mock_usbd_counters()->xfer_violations, 0);
+    return xinput_test_result();
+}
@@ -0,0 +1,353 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Record/replay log: encoding round trip, what the driver records during
+// sessions driven by sendReport() and by publishReport() with suspend, resume
+// and a bus reset, replaying a session back through the driver, and behaviour
+// on full buffers and truncated logs.
+
+#include "xinput_recorder.hpp"
+#include "xinput_report.hpp"
+#include "xinput_test.hpp"
+
+#include <stdlib.h>
+
+static Adafruit_USBD_XInput xinput;
+
+static uint8_t ep_in;
+static uint8_t ep_out;
+static uint32_t rumble_calls;
+
+static void on_rumble(uint8_t left, uint8_t right) {
+    (void)left;
+    (void)right;
+    rumble_calls++;
+}
+
+static xinput_report_t make_report(uint16_t buttons, int16_t lx) {
+    xinput_report_t report = {};
+    report.report_size = sizeof(xinput_report_t);
+    xinput_report_set_buttons(&report, buttons);
+    report.lx = lx;
+    return report;
+}
+
+static void test_round_trip(void) {
+    static uint8_t buffer[64 * 1024];
+    xinput_recorder_t recorder;
+    xinput_recorder_init(&recorder, buffer, sizeof(buffer));
+
+    // Random mix of records with random gaps, kept for comparison
+    struct {
+        uint8_t type;
+        uint32_t time_us;
+        xinput_report_t report;
+        uint8_t out[EPSIZE];
+        uint8_t length;
+    } expected[1000];
+
+    srand(2);
+    uint32_t now_us = 0xFFFF0000; // wraps during the run
+    xinput_report_t report = make_report(0, 0);
+    for (auto &e : expected) {
+        now_us += (uint32_t)(rand() % 3 ? rand() % 2000 : rand());
+        e.time_us = now_us;
+        e.type = (uint8_t)(1 + rand() % 3);
+        if (e.type == XINPUT_LOG_REPORT) {
+            ((uint8_t *)&report)[2 + rand() % 18] = (uint8_t)rand();
+            e.report = report;
+            XINPUT_CHECK(xinput_recorder_report(&recorder, now_us, &report));
+        } else if (e.type == XINPUT_LOG_OUT) {
+            e.length = (uint8_t)(rand() % (EPSIZE + 1));
+            for (uint8_t i = 0; i < e.length; i++) {
+                e.out[i] = (uint8_t)rand();
+            }
+            XINPUT_CHECK(xinput_recorder_out(&recorder, now_us, e.out, e.length));
+        } else {
+            e.length = (uint8_t)(rand() % 4);
+            XINPUT_CHECK(xinput_recorder_event(&recorder, now_us, e.length));
+        }
+    }
+    XINPUT_CHECK_EQ(recorder.dropped, 0);
+
+    xinput_log_reader_t reader;
+    xinput_log_record_t record;
+    xinput_log_reader_init(&reader, buffer, recorder.length);
+    for (auto &e : expected) {
+        XINPUT_CHECK(xinput_log_read(&reader, &record));
+        XINPUT_CHECK_EQ(record.type, e.type);
+        XINPUT_CHECK_EQ(record.time_us, e.time_us - expected[0].time_us);
+        if (e.type == XINPUT_LOG_REPORT) {
+            XINPUT_CHECK(memcmp(record.report, &e.report, sizeof(xinput_report_t)) == 0);
+        } else if (e.type == XINPUT_LOG_OUT) {
+            XINPUT_CHECK_EQ(record.length, e.length);
+            XINPUT_CHECK(memcmp(record.data, e.out, e.length) == 0);
+        } else {
+            XINPUT_CHECK_EQ(record.event, e.length);
+        }
+    }
+    XINPUT_CHECK(!xinput_log_read(&reader, &record));
+
+    // Cut anywhere, the reader stops at the last complete record
+    for (uint32_t cut = 0; cut < 200; cut++) {
+        uint32_t count = 0;
+        xinput_log_reader_init(&reader, buffer, cut);
+        while (xinput_log_read(&reader, &record)) {
+            count++;
+        }
+        XINPUT_CHECK(reader.pos <= cut);
+        XINPUT_CHECK(count < 200);
+    }
+}
+
+static void test_full(void) {
+    // Room for one report against the zero report and one event
+    uint8_t buffer[16];
+    xinput_recorder_t recorder;
+    xinput_recorder_init(&recorder, buffer, sizeof(buffer));
+
+    // A dropped report must not become the delta base of the next one
+    xinput_report_t a = make_report(XINPUT_BUTTON_A, 100), b = make_report(XINPUT_BUTTON_B, 200);
+    XINPUT_CHECK(xinput_recorder_report(&recorder, 0, &a));
+    XINPUT_CHECK(!xinput_recorder_report(&recorder, 10, &b));
+    XINPUT_CHECK_EQ(recorder.dropped, 1);
+    XINPUT_CHECK(xinput_recorder_event(&recorder, 20, XINPUT_LOG_EVENT_RESET));
+
+    xinput_log_reader_t reader;
+    xinput_log_record_t record;
+    xinput_log_reader_init(&reader, buffer, recorder.length);
+    XINPUT_CHECK(xinput_log_read(&reader, &record));
+    XINPUT_CHECK(memcmp(record.report, &a, sizeof(a)) == 0);
+    XINPUT_CHECK(xinput_log_read(&reader, &record));
+    XINPUT_CHECK_EQ(record.type, XINPUT_LOG_EVENT);
+    XINPUT_CHECK_EQ(record.time_us, 20);
+}
+
+// Records a session through the driver and returns the log length
+static uint32_t record_session(uint8_t *buffer, uint32_t capacity, xinput_recorder_t *recorder) {
+    const uint8_t rumble[] = { 0x00, 0x08, 0x00, 0x40, 0x80, 0x00, 0x00, 0x00 };
+    xinput_report_t read;
+
+    xinput_recorder_init(recorder, buffer, capacity);
+    xinput.setRecorder(recorder);
+    XINPUT_CHECK(xinput_test_attach());
+    xinput_test_read(ep_in, &read);
+
+    for (int16_t i = 1; i <= 10; i++) {
+        xinput_report_t report = make_report(0, i);
+        XINPUT_CHECK(xinput.sendReport(&report));
+        mock_time_advance_us(1000);
+        xinput_test_read(ep_in, &read);
+    }
+    XINPUT_CHECK(mock_usbd_out(ep_out, rumble, sizeof(rumble)));
+
+    // Suspend and resume are seen by the next sendReport() and recorded
+    // before the report the host reads after resume
+    xinput_report_t report = make_report(0, 10);
+    mock_usbd_suspend(true);
+    XINPUT_CHECK(!xinput.sendReport(&report));
+    mock_usbd_suspend(false);
+    report.lx = 11;
+    XINPUT_CHECK(xinput.sendReport(&report));
+    mock_time_advance_us(1000);
+    xinput_test_read(ep_in, &read);
+
+    // Sent but never read: not recorded
+    report.lx = 12;
+    XINPUT_CHECK(xinput.sendReport(&report));
+
+    mock_usbd_bus_reset();
+    xinput.setRecorder(NULL);
+    return recorder->length;
+}
+
+static void test_driver_session(void) {
+    static uint8_t buffer[4096];
+    xinput_recorder_t recorder;
+    const uint32_t length = record_session(buffer, sizeof(buffer), &recorder);
+
+    const struct {
+        uint8_t type;
+        uint8_t event;
+    } expected[] = {
+        { XINPUT_LOG_EVENT, XINPUT_LOG_EVENT_RESET },
+        { XINPUT_LOG_EVENT, XINPUT_LOG_EVENT_MOUNT },
+        { XINPUT_LOG_REPORT, 0 },
+        { XINPUT_LOG_REPORT, 0 },
+        { XINPUT_LOG_REPORT, 0 },
+        { XINPUT_LOG_REPORT, 0 },
+        { XINPUT_LOG_REPORT, 0 },
+        { XINPUT_LOG_REPORT, 0 },
+        { XINPUT_LOG_REPORT, 0 },
+        { XINPUT_LOG_REPORT, 0 },
+        { XINPUT_LOG_REPORT, 0 },
+        { XINPUT_LOG_REPORT, 0 },
+        { XINPUT_LOG_OUT, 0 },
+        { XINPUT_LOG_EVENT, XINPUT_LOG_EVENT_SUSPEND },
+        { XINPUT_LOG_EVENT, XINPUT_LOG_EVENT_RESUME },
+        { XINPUT_LOG_REPORT, 0 },
+        { XINPUT_LOG_EVENT, XINPUT_LOG_EVENT_RESET },
+    };
+
+    xinput_log_reader_t reader;
+    xinput_log_record_t record;
+    xinput_log_reader_init(&reader, buffer, length);
+    for (const auto &e : expected) {
+        XINPUT_CHECK(xinput_log_read(&reader, &record));
+        XINPUT_CHECK_EQ(record.type, e.type);
+        if (e.type == XINPUT_LOG_EVENT) {
+            XINPUT_CHECK_EQ(record.event, e.event);
+        }
+    }
+    XINPUT_CHECK(!xinput_log_read(&reader, &record));
+}
+
+// A session driven by publishReport() and SOF only, with reports superseded
+// before the host read them
+static void test_publish_session(void) {
+    static uint8_t buffer[1024];
+    xinput_recorder_t recorder;
+    xinput_report_t read;
+
+    xinput_recorder_init(&recorder, buffer, sizeof(buffer));
+    xinput.setRecorder(&recorder);
+    XINPUT_CHECK(xinput_test_attach());
+    while (xinput_test_read(ep_in, &read)) {
+    }
+
+    const int16_t published[] = { 21, 22, 23 };
+    for (int16_t lx : published) {
+        xinput_report_t report = make_report(0, lx);
+        XINPUT_CHECK(xinput.publishReport(&report));
+    }
+    mock_usbd_sof();
+    mock_time_advance_us(500);
+    XINPUT_CHECK(xinput_test_read(ep_in, &read));
+
+    // Suspend and resume noticed by publishReport(), recorded on the next SOF
+    xinput_report_t report = make_report(0, 24);
+    mock_usbd_suspend(true);
+    mock_time_advance_us(5000);
+    XINPUT_CHECK(xinput.publishReport(&report));
+    mock_time_advance_us(5000);
+    mock_usbd_suspend(false);
+    report.lx = 25;
+    XINPUT_CHECK(xinput.publishReport(&report));
+    mock_time_advance_us(500);
+    mock_usbd_sof();
+    mock_time_advance_us(500);
+    XINPUT_CHECK(xinput_test_read(ep_in, &read));
+    xinput.setRecorder(NULL);
+
+    const struct {
+        uint8_t type;
+        uint8_t event;
+        int16_t lx;
+    } expected[] = {
+        { XINPUT_LOG_EVENT, XINPUT_LOG_EVENT_RESET, 0 },
+        { XINPUT_LOG_EVENT, XINPUT_LOG_EVENT_MOUNT, 0 },
+        { XINPUT_LOG_REPORT, 0, 12 }, // left pending by the previous session, resynced
+        { XINPUT_LOG_REPORT, 0, 23 },
+        { XINPUT_LOG_EVENT, XINPUT_LOG_EVENT_SUSPEND, 0 },
+        { XINPUT_LOG_EVENT, XINPUT_LOG_EVENT_RESUME, 0 },
+        { XINPUT_LOG_REPORT, 0, 25 },
+    };
+
+    xinput_log_reader_t reader;
+    xinput_log_record_t record;
+    uint32_t suspend_us = 0;
+    xinput_log_reader_init(&reader, buffer, recorder.length);
+    for (const auto &e : expected) {
+        XINPUT_CHECK(xinput_log_read(&reader, &record));
+        XINPUT_CHECK_EQ(record.type, e.type);
+        if (e.type == XINPUT_LOG_EVENT) {
+            XINPUT_CHECK_EQ(record.event, e.event);
+        } else {
+            XINPUT_CHECK_EQ(record.report->lx, e.lx);
+        }
+        if (e.event == XINPUT_LOG_EVENT_SUSPEND) {
+            suspend_us = record.time_us;
+        } else if (e.event == XINPUT_LOG_EVENT_RESUME) {
+            // Recorded with the time it was seen, not when it was written
+            XINPUT_CHECK(record.time_us - suspend_us >= 5000);
+            XINPUT_CHECK(record.time_us - suspend_us < 6000);
+        }
+    }
+    XINPUT_CHECK(!xinput_log_read(&reader, &record));
+}
+
+static uint32_t count_records(const uint8_t *buffer, uint32_t length) {
+    xinput_log_reader_t reader;
+    xinput_log_record_t record;
+    uint32_t count = 0;
+    xinput_log_reader_init(&reader, buffer, length);
+    while (xinput_log_read(&reader, &record)) {
+        count++;
+    }
+    return count;
+}
+
+static void test_replay(void) {
+    static uint8_t buffer[4096];
+    xinput_recorder_t recorder;
+    const uint32_t length = record_session(buffer, sizeof(buffer), &recorder);
+    const uint32_t records = count_records(buffer, length);
+
+    XINPUT_CHECK(mock_usbd_configure());
+    xinput_report_t read;
+    xinput_test_read(ep_in, &read);
+
+    // As fast as possible: every record is played, OUT packets reach the
+    // callbacks and the host ends up with the newest report
+    rumble_calls = 0;
+    XINPUT_CHECK_EQ(xinput.replay(buffer, length, false), records);
+    XINPUT_CHECK_EQ(rumble_calls, 1);
+    while (xinput_test_read(ep_in, &read)) {
+    }
+    XINPUT_CHECK_EQ(read.lx, 11);
+
+    // In real time the recorded gaps are reproduced on the virtual clock
+    const uint32_t start_us = micros();
+    XINPUT_CHECK_EQ(xinput.replay(buffer, length, true), records);
+    XINPUT_CHECK(micros() - start_us >= 10000);
+
+    // Replaying did not record into the log being played
+    XINPUT_CHECK_EQ(recorder.length, length);
+}
+
+int main(void) {
+    XINPUT_CHECK(xinput.begin());
+    xinput.onRumble(on_rumble);
+    XINPUT_CHECK(xinput_test_attach());
+    ep_in = mock_usbd_endpoint(0, TUSB_DIR_IN);
+    ep_out = mock_usbd_endpoint(0, TUSB_DIR_OUT);
+    mock_usbd_bus_reset();
+
+    test_round_trip();
+    test_full();
+    test_driver_session();
+    test_publish_session();
+    test_replay();
+    return xinput_test_result();
+}
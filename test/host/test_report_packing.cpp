@@ -0,0 +1,133 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Report packing: the button word and explicit little-endian fields must
+// produce the same bytes as the xinput_report_t bitfields, and the compile
+// time pin remap must agree with a plain per-bit translation.
+
+#include "xinput_report.hpp"
+#include "xinput_test.hpp"
+
+#include <stdlib.h>
+
+struct button_field {
+    uint16_t mask;
+    bool (*get)(const xinput_report_t *report);
+};
+
+#define BUTTON_FIELD(_mask, _field) \
+    { _mask, [](const xinput_report_t *r) { return (bool)r->_field; } }
+
+static const button_field button_fields[] = {
+    BUTTON_FIELD(XINPUT_BUTTON_DPAD_UP, dpad_up),
+    BUTTON_FIELD(XINPUT_BUTTON_DPAD_DOWN, dpad_down),
+    BUTTON_FIELD(XINPUT_BUTTON_DPAD_LEFT, dpad_left),
+    BUTTON_FIELD(XINPUT_BUTTON_DPAD_RIGHT, dpad_right),
+    BUTTON_FIELD(XINPUT_BUTTON_START, start),
+    BUTTON_FIELD(XINPUT_BUTTON_BACK, back),
+    BUTTON_FIELD(XINPUT_BUTTON_LS, ls),
+    BUTTON_FIELD(XINPUT_BUTTON_RS, rs),
+    BUTTON_FIELD(XINPUT_BUTTON_LB, lb),
+    BUTTON_FIELD(XINPUT_BUTTON_RB, rb),
+    BUTTON_FIELD(XINPUT_BUTTON_HOME, home),
+    BUTTON_FIELD(XINPUT_BUTTON_A, a),
+    BUTTON_FIELD(XINPUT_BUTTON_B, b),
+    BUTTON_FIELD(XINPUT_BUTTON_X, x),
+    BUTTON_FIELD(XINPUT_BUTTON_Y, y),
+};
+
+// Pins in reverse order over the upper half of the bank, home not wired
+static constexpr uint8_t remap_pins[XINPUT_BUTTON_COUNT] = {
+    31, 30, 29, 28, 27, 26, 25, 24, 23, 22, XINPUT_PIN_NONE, 21, 20, 19, 18, 17,
+};
+static constexpr xinput_button_remap_t remap = xinput_button_remap(remap_pins);
+
+static uint16_t remap_reference(uint32_t gpio) {
+    uint16_t buttons = 0;
+    for (uint8_t bit = 0; bit < XINPUT_BUTTON_COUNT; bit++) {
+        if (remap_pins[bit] != XINPUT_PIN_NONE && (gpio >> remap_pins[bit]) & 1) {
+            buttons |= (uint16_t)(1u << bit);
+        }
+    }
+    return buttons;
+}
+
+static void test_buttons(void) {
+    for (const button_field &field : button_fields) {
+        xinput_report_t report = {};
+        xinput_report_set_buttons(&report, field.mask);
+        for (const button_field &other : button_fields) {
+            XINPUT_CHECK_EQ(other.get(&report), other.mask == field.mask);
+        }
+        XINPUT_CHECK_EQ(xinput_report_get_buttons(&report), field.mask);
+    }
+
+    // The other bytes are left alone
+    xinput_report_t report;
+    memset(&report, 0xA5, sizeof(report));
+    xinput_report_set_buttons(&report, 0);
+    XINPUT_CHECK_EQ(((uint8_t *)&report)[1], 0xA5);
+    XINPUT_CHECK_EQ(((uint8_t *)&report)[4], 0xA5);
+}
+
+static void test_axes(void) {
+    xinput_report_t report = {};
+    xinput_report_set_triggers(&report, 0x12, 0xFE);
+    xinput_report_set_sticks(&report, -32768, 32767, 0x1234, -2);
+    XINPUT_CHECK_EQ(report.lt, 0x12);
+    XINPUT_CHECK_EQ(report.rt, 0xFE);
+    XINPUT_CHECK_EQ(report.lx, -32768);
+    XINPUT_CHECK_EQ(report.ly, 32767);
+    XINPUT_CHECK_EQ(report.rx, 0x1234);
+    XINPUT_CHECK_EQ(report.ry, -2);
+
+    // Wire order is little-endian whatever the host byte order
+    const uint8_t *bytes = (const uint8_t *)&report;
+    XINPUT_CHECK_EQ(bytes[XINPUT_REPORT_RX_OFFSET], 0x34);
+    XINPUT_CHECK_EQ(bytes[XINPUT_REPORT_RX_OFFSET + 1], 0x12);
+    XINPUT_CHECK_EQ(bytes[XINPUT_REPORT_RY_OFFSET], 0xFE);
+    XINPUT_CHECK_EQ(bytes[XINPUT_REPORT_RY_OFFSET + 1], 0xFF);
+}
+
+static void test_remap(void) {
+    for (uint8_t bit = 0; bit < XINPUT_BUTTON_COUNT; bit++) {
+        if (remap_pins[bit] != XINPUT_PIN_NONE) {
+            XINPUT_CHECK_EQ(xinput_button_remap_apply(&remap, 1u << remap_pins[bit]), 1u << bit);
+        }
+    }
+    XINPUT_CHECK_EQ(xinput_button_remap_apply(&remap, 0x0001FFFF), 0);
+
+    srand(1);
+    for (int i = 0; i < 100000; i++) {
+        const uint32_t gpio = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+        XINPUT_CHECK_EQ(xinput_button_remap_apply(&remap, gpio), remap_reference(gpio));
+    }
+}
+
+int main(void) {
+    test_buttons();
+    test_axes();
+    test_remap();
+    return xinput_test_result();
+}
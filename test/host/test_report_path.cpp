@@ -0,0 +1,223 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Drives the IN and OUT report paths through the mock device stack: resync on
+// open, latest-wins submission, failed submissions, reports sent while the
+// interface is closed, and OUT decoding, queuing and flushing on reset.
+
+#include "xinput_test.hpp"
+
+static Adafruit_USBD_XInput xinput;
+
+static uint8_t ep_in;
+static uint8_t ep_out;
+
+static uint8_t rumble_left;
+static uint8_t rumble_right;
+static uint32_t rumble_calls;
+static bool rearmed_before_decode;
+
+static void on_rumble(uint8_t left, uint8_t right) {
+    rumble_left = left;
+    rumble_right = right;
+    rumble_calls++;
+    rearmed_before_decode &= mock_usbd_armed(ep_out);
+}
+
+static xinput_report_t make_report(int16_t lx) {
+    xinput_report_t report = {};
+    report.report_size = sizeof(xinput_report_t);
+    report.lx = lx;
+    return report;
+}
+
+static void test_open(void) {
+    XINPUT_CHECK(mock_usbd_sof_enabled());
+    XINPUT_CHECK(mock_usbd_armed(ep_out));
+
+    // Nothing was published yet, so there is nothing to resync the host with
+    xinput_report_t read;
+    XINPUT_CHECK(!xinput_test_read(ep_in, &read));
+    XINPUT_CHECK(xinput.ready());
+}
+
+static void test_latest_wins(void) {
+    xinput_report_t a = make_report(1), b = make_report(2), c = make_report(3);
+    xinput_report_t read;
+
+    // Idle endpoint: submitted right away
+    XINPUT_CHECK(xinput.sendReport(&a));
+    XINPUT_CHECK(!xinput.ready());
+
+    // Busy endpoint: b is superseded by c before the host reads a
+    XINPUT_CHECK(xinput.sendReport(&b));
+    XINPUT_CHECK(xinput.sendReport(&c));
+    XINPUT_CHECK(xinput_test_read(ep_in, &read));
+    XINPUT_CHECK_EQ(read.lx, 1);
+    XINPUT_CHECK(xinput_test_read(ep_in, &read));
+    XINPUT_CHECK_EQ(read.lx, 3);
+    XINPUT_CHECK(!xinput_test_read(ep_in, &read));
+}
+
+static void test_failed_submit(void) {
+    xinput_report_t d = make_report(4);
+    xinput_report_t read;
+
+    // The report stays pending and goes out on the next SOF
+    mock_usbd_fail_next_xfer(ep_in);
+    XINPUT_CHECK(xinput.sendReport(&d));
+    XINPUT_CHECK(!mock_usbd_armed(ep_in));
+    mock_usbd_sof();
+    XINPUT_CHECK(xinput_test_read(ep_in, &read));
+    XINPUT_CHECK_EQ(read.lx, 4);
+
+    // Flushing twice must not send an older report again
+    XINPUT_CHECK(!xinput.flush());
+    XINPUT_CHECK(!xinput_test_read(ep_in, &read));
+}
+
+static void test_closed(void) {
+    xinput_report_t e = make_report(5);
+    xinput_report_t read;
+
+    mock_usbd_bus_reset();
+    XINPUT_CHECK(!xinput.ready());
+    XINPUT_CHECK(xinput.sendReport(&e));
+
+    // The report sent during the outage is what the host gets on reopen
+    XINPUT_CHECK(mock_usbd_configure());
+    XINPUT_CHECK(xinput_test_read(ep_in, &read));
+    XINPUT_CHECK_EQ(read.lx, 5);
+    XINPUT_CHECK(!xinput_test_read(ep_in, &read));
+
+    // Without a newer one, the last report sent is resent and counted like
+    // any other submission
+    xinput_stats_t before, after;
+    xinput.getStats(&before);
+    mock_usbd_bus_reset();
+    XINPUT_CHECK(mock_usbd_configure());
+    XINPUT_CHECK(xinput_test_read(ep_in, &read));
+    XINPUT_CHECK_EQ(read.lx, 5);
+    xinput.getStats(&after);
+    XINPUT_CHECK_EQ(after.submitted, before.submitted + 1);
+    XINPUT_CHECK_EQ(after.completed, before.completed + 1);
+}
+
+static void test_out(void) {
+    const uint8_t rumble[] = { 0x00, 0x08, 0x00, 0x40, 0x80, 0x00, 0x00, 0x00 };
+    const uint8_t led[] = { 0x01, 0x03, 0x0A };
+    uint8_t left, right;
+
+    xinput.onRumble(on_rumble);
+    rearmed_before_decode = true;
+
+    // Without queuing, callbacks and getRumble() see every packet and
+    // nothing counts as dropped
+    for (int i = 0; i < 10; i++) {
+        XINPUT_CHECK(mock_usbd_out(ep_out, rumble, sizeof(rumble)));
+    }
+    XINPUT_CHECK(mock_usbd_out(ep_out, led, sizeof(led)));
+    XINPUT_CHECK_EQ(rumble_calls, 10);
+    XINPUT_CHECK(rearmed_before_decode);
+    XINPUT_CHECK(xinput.getRumble(&left, &right));
+    XINPUT_CHECK_EQ(left, 0x40);
+    XINPUT_CHECK_EQ(right, 0x80);
+    XINPUT_CHECK(!xinput.getRumble(&left, &right));
+    XINPUT_CHECK_EQ(xinput.ledPattern(), 0x0A);
+    XINPUT_CHECK_EQ(xinput.outPacketsAvailable(), 0);
+    XINPUT_CHECK_EQ(xinput.outPacketsDropped(), 0);
+
+    // With queuing, packets beyond the queue depth are dropped from the queue
+    // but still decoded, and the endpoint is still re-armed first
+    xinput.setOutQueue(true);
+    for (uint8_t i = 0; i < CFG_XINPUT_OUT_QUEUE + 1; i++) {
+        uint8_t packet[sizeof(rumble)];
+        memcpy(packet, rumble, sizeof(rumble));
+        packet[3] = i;
+        XINPUT_CHECK(mock_usbd_out(ep_out, packet, sizeof(packet)));
+    }
+    XINPUT_CHECK(rearmed_before_decode);
+    XINPUT_CHECK_EQ(rumble_calls, 10 + CFG_XINPUT_OUT_QUEUE + 1);
+    XINPUT_CHECK_EQ(xinput.outPacketsAvailable(), CFG_XINPUT_OUT_QUEUE);
+    XINPUT_CHECK_EQ(xinput.outPacketsDropped(), 1);
+
+    for (uint8_t i = 0; i < CFG_XINPUT_OUT_QUEUE; i++) {
+        uint8_t packet[EPSIZE];
+        XINPUT_CHECK_EQ(xinput.readOutPacket(packet, sizeof(packet)), sizeof(rumble));
+        XINPUT_CHECK_EQ(packet[3], i);
+    }
+    XINPUT_CHECK_EQ(xinput.outPacketsAvailable(), 0);
+
+    // A bus reset drops what the reader has not read yet, and packets of
+    // the next session queue normally
+    XINPUT_CHECK(mock_usbd_out(ep_out, rumble, sizeof(rumble)));
+    XINPUT_CHECK(mock_usbd_out(ep_out, led, sizeof(led)));
+    XINPUT_CHECK_EQ(xinput.outPacketsAvailable(), 2);
+    mock_usbd_bus_reset();
+    XINPUT_CHECK_EQ(xinput.outPacketsAvailable(), 0);
+    XINPUT_CHECK(mock_usbd_configure());
+    XINPUT_CHECK(mock_usbd_out(ep_out, led, sizeof(led)));
+    XINPUT_CHECK_EQ(xinput.outPacketsAvailable(), 1);
+    uint8_t packet[EPSIZE];
+    XINPUT_CHECK_EQ(xinput.readOutPacket(packet, sizeof(packet)), sizeof(led));
+    XINPUT_CHECK_EQ(packet[0], XINPUT_OUT_LED);
+    XINPUT_CHECK_EQ(xinput.readOutPacket(packet, sizeof(packet)), 0);
+    xinput.setOutQueue(false);
+
+    // A bus reset stops the motors through the callback as well
+    XINPUT_CHECK(mock_usbd_out(ep_out, rumble, sizeof(rumble)));
+    mock_usbd_bus_reset();
+    XINPUT_CHECK_EQ(rumble_left, 0);
+    XINPUT_CHECK_EQ(rumble_right, 0);
+    XINPUT_CHECK(xinput.getRumble(&left, &right));
+    XINPUT_CHECK_EQ(left, 0);
+    XINPUT_CHECK(mock_usbd_configure());
+}
+
+static void test_stats(void) {
+    xinput_stats_t stats;
+    xinput.getStats(&stats);
+    XINPUT_CHECK(stats.submitted > 0);
+    XINPUT_CHECK(stats.completed > 0);
+    XINPUT_CHECK(stats.out_received > 0);
+    XINPUT_CHECK_EQ(stats.out_overruns, xinput.outPacketsDropped());
+}
+
+int main(void) {
+    XINPUT_CHECK(xinput.begin());
+    XINPUT_CHECK(xinput_test_attach());
+    ep_in = mock_usbd_endpoint(0, TUSB_DIR_IN);
+    ep_out = mock_usbd_endpoint(0, TUSB_DIR_OUT);
+    XINPUT_CHECK(ep_in && ep_out);
+
+    test_open();
+    test_latest_wins();
+    test_failed_submit();
+    test_closed();
+    test_out();
+    test_stats();
+
+    XINPUT_CHECK_EQ(mock_usbd_counters()->xfer_violations, 0);
+    return xinput_test_result();
+}
@@ -0,0 +1,119 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// IN completion events against the mock device stack: onReportSent() runs for
+// every report the host read and not for failed transfers, after the pending
+// report was submitted; waitReportSent() latches a completion, times out on
+// the virtual clock and wakes a thread waiting for the host.
+
+#include "xinput_test.hpp"
+
+#include <atomic>
+#include <thread>
+
+static Adafruit_USBD_XInput xinput;
+
+static uint8_t ep_in;
+static uint32_t sent_calls;
+static bool armed_in_callback;
+
+static void on_report_sent(void) {
+    sent_calls++;
+    armed_in_callback = mock_usbd_armed(ep_in);
+}
+
+static xinput_report_t make_report(int16_t lx) {
+    xinput_report_t report = {};
+    report.report_size = sizeof(xinput_report_t);
+    report.lx = lx;
+    return report;
+}
+
+static void test_callback(void) {
+    const xinput_report_t a = make_report(1), b = make_report(2);
+    xinput_report_t read;
+    xinput.onReportSent(on_report_sent);
+
+    XINPUT_CHECK(xinput.sendReport(&a));
+    XINPUT_CHECK(xinput.sendReport(&b));
+    XINPUT_CHECK(xinput_test_read(ep_in, &read));
+    XINPUT_CHECK_EQ(sent_calls, 1);
+    XINPUT_CHECK(armed_in_callback);
+
+    XINPUT_CHECK(xinput_test_read(ep_in, &read));
+    XINPUT_CHECK_EQ(sent_calls, 2);
+    XINPUT_CHECK(!armed_in_callback);
+
+    XINPUT_CHECK(xinput.sendReport(&a));
+    XINPUT_CHECK(mock_usbd_in_fail(ep_in, XFER_RESULT_FAILED));
+    XINPUT_CHECK_EQ(sent_calls, 2);
+
+    xinput.onReportSent(NULL);
+    XINPUT_CHECK(xinput.sendReport(&b));
+    XINPUT_CHECK(xinput_test_read(ep_in, &read));
+    XINPUT_CHECK_EQ(sent_calls, 2);
+}
+
+static void test_wait(void) {
+    const xinput_report_t a = make_report(3);
+    xinput_report_t read;
+
+    // A completion since the previous call is returned right away, once
+    const uint32_t start_ms = millis();
+    XINPUT_CHECK(xinput.waitReportSent(10));
+    XINPUT_CHECK(millis() - start_ms < 10);
+    XINPUT_CHECK(!xinput.waitReportSent(10));
+    XINPUT_CHECK(millis() - start_ms >= 10);
+
+    XINPUT_CHECK(xinput.sendReport(&a));
+    XINPUT_CHECK(mock_usbd_in_fail(ep_in, XFER_RESULT_STALLED));
+    XINPUT_CHECK(!xinput.waitReportSent(10));
+
+    // A waiting thread is woken by the host's read
+    std::atomic<bool> waiting(false);
+    std::atomic<bool> sent(false);
+    std::thread waiter([&]() {
+        waiting.store(true);
+        sent.store(xinput.waitReportSent(60000));
+    });
+    while (!waiting.load()) {
+        std::this_thread::yield();
+    }
+    XINPUT_CHECK(xinput.sendReport(&a));
+    XINPUT_CHECK(xinput_test_read(ep_in, &read));
+    waiter.join();
+    XINPUT_CHECK(sent.load());
+}
+
+int main(void) {
+    XINPUT_CHECK(xinput.begin());
+    XINPUT_CHECK(xinput_test_attach());
+    ep_in = mock_usbd_endpoint(0, TUSB_DIR_IN);
+
+    test_callback();
+    test_wait();
+
+    XINPUT_CHECK_EQ(mock_usbd_counters()->xfer_violations, 0);
+    return xinput_test_result();
+}
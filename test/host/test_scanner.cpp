@@ -0,0 +1,128 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Debounced scanner against a per-button reference debouncer over synthetic
+// bounce traces: contact bounce on every press and release, short glitches
+// on held buttons and random noise on all 32 GPIO bits.
+
+#include "xinput_scanner.hpp"
+#include "xinput_test.hpp"
+
+#include <stdlib.h>
+
+#define DEBOUNCE_SCANS 4
+
+static constexpr uint8_t pins[XINPUT_BUTTON_COUNT] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, XINPUT_PIN_NONE, 11, 12, 13, 14,
+};
+static constexpr xinput_button_remap_t remap = xinput_button_remap(pins);
+
+// One counter per input, the textbook integrator the vertical counter
+// implements in parallel
+typedef struct {
+    uint32_t state;
+    uint8_t count[32];
+} reference_t;
+
+static uint32_t reference_update(reference_t *ref, uint32_t raw) {
+    for (uint8_t bit = 0; bit < 32; bit++) {
+        if (((raw ^ ref->state) >> bit) & 1) {
+            if (++ref->count[bit] == DEBOUNCE_SCANS) {
+                ref->state ^= 1u << bit;
+                ref->count[bit] = 0;
+            }
+        } else {
+            ref->count[bit] = 0;
+        }
+    }
+    return ref->state;
+}
+
+static void test_reference(void) {
+    xinput_scanner_t scanner;
+    reference_t ref = {};
+    xinput_scanner_init(&scanner, &remap, 0);
+
+    srand(3);
+    for (int i = 0; i < 200000; i++) {
+        // Mostly stable bits with occasional runs of noise
+        const uint32_t raw = (i / 7) % 3 ? (uint32_t)rand() : ref.state ^ (1u << (rand() % 32));
+        const uint16_t buttons = xinput_scanner_update(&scanner, raw);
+        const uint32_t expected = reference_update(&ref, raw);
+        XINPUT_CHECK_EQ(scanner.state, expected);
+        XINPUT_CHECK_EQ(buttons, xinput_button_remap_apply(&remap, expected));
+        XINPUT_CHECK_EQ(xinput_scanner_buttons(&scanner), buttons);
+    }
+}
+
+// A button press with contact bounce: bounce_scans of random level after
+// each edge, then the settled level
+static void test_bounce(void) {
+    xinput_scanner_t scanner;
+    // Pull-ups: the A button reads 0 when pressed
+    const uint32_t pin_a = 1u << 11;
+    xinput_scanner_init(&scanner, &remap, pin_a);
+
+    srand(4);
+    uint32_t presses = 0, edges = 0, max_latency = 0;
+    bool pressed = false;
+    uint16_t previous = 0;
+
+    for (int cycle = 0; cycle < 2000; cycle++) {
+        pressed = !pressed;
+        const uint32_t level = pressed ? 0 : pin_a;
+        const int bounce_scans = rand() % 8;
+        const int hold_scans = 20 + rand() % 20;
+        presses += pressed;
+
+        for (int t = 0; t < bounce_scans + hold_scans; t++) {
+            uint32_t raw = t < bounce_scans && rand() % 2 ? level ^ pin_a : level;
+            // A glitch shorter than the debounce time while held
+            if (t == bounce_scans + 10 && rand() % 2) {
+                raw ^= pin_a;
+            }
+            const uint16_t buttons = xinput_scanner_update(&scanner, raw);
+            if (buttons != previous) {
+                edges++;
+                const uint32_t latency = (uint32_t)t;
+                max_latency = latency > max_latency ? latency : max_latency;
+                XINPUT_CHECK_EQ(buttons, pressed ? XINPUT_BUTTON_A : 0);
+            }
+            previous = buttons;
+        }
+        XINPUT_CHECK_EQ(previous, pressed ? XINPUT_BUTTON_A : 0);
+    }
+
+    // Exactly one debounced edge per press and release, at most the bounce
+    // time plus the debounce time after the contact first moved
+    XINPUT_CHECK_EQ(edges, 2000);
+    XINPUT_CHECK_EQ(presses, 1000);
+    XINPUT_CHECK(max_latency <= 7 + DEBOUNCE_SCANS);
+}
+
+int main(void) {
+    test_reference();
+    test_bounce();
+    return xinput_test_result();
+}
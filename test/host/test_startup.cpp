@@ -0,0 +1,84 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Startup milestones: startupTimes() records the first time each one is
+// reached, startupComplete() turns true with the first IN report the host
+// reads, and later resets and reads do not move them. Times are odd because
+// a milestone has its lowest bit set so that 0 can mean not reached.
+
+#include "xinput_test.hpp"
+
+int main(void) {
+    mock_time_set_us(1001);
+    Adafruit_USBD_XInput *xinput = new Adafruit_USBD_XInput();
+    const xinput_startup_t &startup = xinput->startupTimes();
+    XINPUT_CHECK_EQ(startup.constructed_us, 1001);
+
+    mock_time_set_us(2001);
+    XINPUT_CHECK(xinput->begin());
+    XINPUT_CHECK_EQ(startup.begun_us, 2001);
+    XINPUT_CHECK_EQ(startup.reset_us, 0);
+    XINPUT_CHECK_EQ(startup.mounted_us, 0);
+    XINPUT_CHECK(!xinput->startupComplete());
+
+    mock_usbd_init();
+    mock_time_set_us(5001);
+    mock_usbd_bus_reset();
+    XINPUT_CHECK_EQ(startup.reset_us, 5001);
+
+    mock_time_set_us(9001);
+    XINPUT_CHECK(mock_usbd_configure());
+    XINPUT_CHECK_EQ(startup.mounted_us, 9001);
+    XINPUT_CHECK_EQ(startup.first_report_us, 0);
+    XINPUT_CHECK(!xinput->startupComplete());
+
+    // Queued is not enough, the host has to read it
+    const uint8_t ep_in = mock_usbd_endpoint(0, TUSB_DIR_IN);
+    xinput_report_t report = {};
+    report.report_size = sizeof(xinput_report_t);
+    report.a = true;
+    mock_time_set_us(12001);
+    XINPUT_CHECK(xinput->sendReport(&report));
+    XINPUT_CHECK(!xinput->startupComplete());
+
+    xinput_report_t read;
+    mock_time_set_us(13001);
+    XINPUT_CHECK(xinput_test_read(ep_in, &read));
+    XINPUT_CHECK(xinput->startupComplete());
+    XINPUT_CHECK_EQ(startup.first_report_us, 13001);
+
+    // A second enumeration leaves the first milestones in place
+    mock_time_set_us(20001);
+    mock_usbd_bus_reset();
+    XINPUT_CHECK(mock_usbd_configure());
+    XINPUT_CHECK(xinput->sendReport(&report));
+    while (xinput_test_read(ep_in, &read)) {
+    }
+    XINPUT_CHECK_EQ(startup.reset_us, 5001);
+    XINPUT_CHECK_EQ(startup.mounted_us, 9001);
+    XINPUT_CHECK_EQ(startup.first_report_us, 13001);
+    XINPUT_CHECK(xinput->startupComplete());
+
+    return xinput_test_result();
+}
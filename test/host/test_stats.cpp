@@ -0,0 +1,145 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Transfer statistics: latency and jitter histogram buckets under virtual
+// time, failed IN transfers staying out of them, and rejected_busy counting
+// deferred sendReport() calls once each rather than every retry.
+
+#include "xinput_test.hpp"
+
+static Adafruit_USBD_XInput xinput;
+
+static uint8_t ep_in;
+
+static xinput_report_t make_report(int16_t lx) {
+    xinput_report_t report = {};
+    report.report_size = sizeof(xinput_report_t);
+    report.lx = lx;
+    return report;
+}
+
+// Sends at send_us and has the host read at read_us
+static void send_and_read(int16_t lx, uint32_t send_us, uint32_t read_us) {
+    const xinput_report_t report = make_report(lx);
+    xinput_report_t read;
+    mock_time_set_us(send_us);
+    XINPUT_CHECK(xinput.sendReport(&report));
+    mock_time_set_us(read_us);
+    XINPUT_CHECK(xinput_test_read(ep_in, &read));
+}
+
+static void test_histograms(void) {
+    xinput_stats_t stats;
+    xinput.resetStats();
+
+    // 300 us latency falls into [256, 512)
+    send_and_read(1, 10000, 10300);
+    xinput.getStats(&stats);
+    XINPUT_CHECK_EQ(stats.completed, 1);
+    XINPUT_CHECK_EQ(stats.latency_hist[2], 1);
+
+    // Completed exactly one 1 ms interval later: no jitter
+    send_and_read(2, 10500, 11300);
+    xinput.getStats(&stats);
+    XINPUT_CHECK_EQ(stats.latency_hist[3], 1);
+    XINPUT_CHECK_EQ(stats.jitter_hist[0], 1);
+
+    // 1800 us latency in [1024, 2048), 2 ms apart is 1000 us of jitter
+    send_and_read(3, 11500, 13300);
+    xinput.getStats(&stats);
+    XINPUT_CHECK_EQ(stats.latency_hist[4], 1);
+    XINPUT_CHECK_EQ(stats.jitter_hist[3], 1);
+    XINPUT_CHECK_EQ(stats.submitted, 3);
+    XINPUT_CHECK_EQ(stats.completed, 3);
+}
+
+static void test_failed_transfer(void) {
+    xinput_stats_t before, after;
+    xinput.getStats(&before);
+
+    // A stalled transfer is neither completed nor measured, and the report
+    // pending behind it goes out
+    const xinput_report_t a = make_report(4), b = make_report(5);
+    xinput_report_t read;
+    mock_time_set_us(20000);
+    XINPUT_CHECK(xinput.sendReport(&a));
+    XINPUT_CHECK(xinput.sendReport(&b));
+    mock_time_set_us(20100);
+    XINPUT_CHECK(mock_usbd_in_fail(ep_in, XFER_RESULT_STALLED));
+
+    xinput.getStats(&after);
+    XINPUT_CHECK_EQ(after.submitted, before.submitted + 2);
+    XINPUT_CHECK_EQ(after.completed, before.completed);
+    XINPUT_CHECK(!memcmp(after.latency_hist, before.latency_hist, sizeof(after.latency_hist)));
+    XINPUT_CHECK(!memcmp(after.jitter_hist, before.jitter_hist, sizeof(after.jitter_hist)));
+
+    mock_time_set_us(20300);
+    XINPUT_CHECK(xinput_test_read(ep_in, &read));
+    XINPUT_CHECK_EQ(read.lx, 5);
+    xinput.getStats(&after);
+    XINPUT_CHECK_EQ(after.completed, before.completed + 1);
+    XINPUT_CHECK(!mock_usbd_in_fail(ep_in, XFER_RESULT_FAILED));
+}
+
+static void test_rejected_busy(void) {
+    const xinput_report_t a = make_report(6), b = make_report(7), c = make_report(8);
+    xinput_report_t read;
+    xinput_stats_t stats;
+    xinput.resetStats();
+
+    XINPUT_CHECK(xinput.sendReport(&a));
+    XINPUT_CHECK(xinput.sendReport(&b));
+
+    // Retrying the deferred report every frame counts nothing more
+    for (int i = 0; i < 5; i++) {
+        mock_usbd_sof();
+    }
+    XINPUT_CHECK(!xinput.flush());
+    XINPUT_CHECK(xinput.sendReport(&c));
+    xinput.getStats(&stats);
+    XINPUT_CHECK_EQ(stats.rejected_busy, 2);
+
+    // publishReport() only hands over, it is never rejected
+    XINPUT_CHECK(xinput.publishReport(&a));
+    mock_usbd_sof();
+    xinput.getStats(&stats);
+    XINPUT_CHECK_EQ(stats.rejected_busy, 2);
+
+    while (xinput_test_read(ep_in, &read)) {
+    }
+    XINPUT_CHECK_EQ(read.lx, 6);
+}
+
+int main(void) {
+    XINPUT_CHECK(xinput.begin());
+    XINPUT_CHECK(xinput_test_attach());
+    ep_in = mock_usbd_endpoint(0, TUSB_DIR_IN);
+
+    test_histograms();
+    test_failed_transfer();
+    test_rejected_busy();
+
+    XINPUT_CHECK_EQ(mock_usbd_counters()->xfer_violations, 0);
+    return xinput_test_result();
+}
@@ -0,0 +1,138 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Suspend handling against the mock device stack: sendReport() refuses
+// reports while suspended, signals remote wakeup once per suspend for changed
+// input and only if the host enabled it, waitResume() times out or returns
+// on resume, and idle() follows the time since the last changed report.
+
+#include "xinput_test.hpp"
+
+static Adafruit_USBD_XInput xinput;
+
+static uint8_t ep_in;
+
+static xinput_report_t make_report(int16_t lx) {
+    xinput_report_t report = {};
+    report.report_size = sizeof(xinput_report_t);
+    report.lx = lx;
+    return report;
+}
+
+static uint32_t remote_wakeups(void) {
+    return mock_usbd_counters()->remote_wakeups;
+}
+
+static void test_suspended_send(void) {
+    const xinput_report_t a = make_report(1), b = make_report(2), c = make_report(3);
+    xinput_report_t read;
+
+    XINPUT_CHECK(xinput.sendReport(&a));
+    XINPUT_CHECK(xinput_test_read(ep_in, &read));
+
+    // Nothing is queued while suspended, and without the host's permission
+    // a change does not wake it
+    mock_usbd_suspend(true);
+    XINPUT_CHECK(xinput.suspended());
+    XINPUT_CHECK(!xinput.sendReport(&b));
+    XINPUT_CHECK(!mock_usbd_armed(ep_in));
+    XINPUT_CHECK_EQ(remote_wakeups(), 0);
+
+    // With it, the first change wakes the host, later ones do not repeat it
+    mock_usbd_set_remote_wakeup(true);
+    XINPUT_CHECK(!xinput.sendReport(&a));
+    XINPUT_CHECK_EQ(remote_wakeups(), 0);
+    XINPUT_CHECK(!xinput.sendReport(&b));
+    XINPUT_CHECK_EQ(remote_wakeups(), 1);
+    XINPUT_CHECK(!xinput.sendReport(&c));
+    XINPUT_CHECK_EQ(remote_wakeups(), 1);
+
+    // After resume the application resends and the report goes out
+    mock_usbd_suspend(false);
+    XINPUT_CHECK(!xinput.suspended());
+    XINPUT_CHECK(xinput.sendReport(&c));
+    XINPUT_CHECK(xinput_test_read(ep_in, &read));
+    XINPUT_CHECK_EQ(read.lx, 3);
+
+    // The next suspend can wake the host again
+    mock_usbd_suspend(true);
+    XINPUT_CHECK(!xinput.sendReport(&c));
+    XINPUT_CHECK_EQ(remote_wakeups(), 1);
+    XINPUT_CHECK(!xinput.sendReport(&a));
+    XINPUT_CHECK_EQ(remote_wakeups(), 2);
+    mock_usbd_suspend(false);
+    mock_usbd_set_remote_wakeup(false);
+}
+
+static void test_wait_resume(void) {
+    XINPUT_CHECK(xinput.waitResume(10));
+
+    mock_usbd_suspend(true);
+    const uint32_t start_ms = millis();
+    XINPUT_CHECK(!xinput.waitResume(10));
+    XINPUT_CHECK(millis() - start_ms >= 10);
+    mock_usbd_suspend(false);
+}
+
+static void test_idle(void) {
+    const xinput_report_t a = make_report(4), b = make_report(5);
+    xinput_report_t read;
+
+    // Disabled by default
+    mock_time_advance_us(1000000);
+    XINPUT_CHECK(!xinput.idle());
+
+    xinput.setIdleTimeout(50);
+    XINPUT_CHECK(xinput.sendReport(&a));
+    XINPUT_CHECK(xinput_test_read(ep_in, &read));
+    mock_time_advance_us(49000);
+    XINPUT_CHECK(!xinput.idle());
+
+    // Resending the same input does not count as activity
+    XINPUT_CHECK(xinput.sendReport(&a));
+    XINPUT_CHECK(xinput_test_read(ep_in, &read));
+    mock_time_advance_us(1000);
+    XINPUT_CHECK(xinput.idle());
+
+    XINPUT_CHECK(xinput.sendReport(&b));
+    XINPUT_CHECK(xinput_test_read(ep_in, &read));
+    XINPUT_CHECK(!xinput.idle());
+
+    xinput.setIdleTimeout(0);
+    mock_time_advance_us(1000000);
+    XINPUT_CHECK(!xinput.idle());
+}
+
+int main(void) {
+    XINPUT_CHECK(xinput.begin());
+    XINPUT_CHECK(xinput_test_attach());
+    ep_in = mock_usbd_endpoint(0, TUSB_DIR_IN);
+
+    test_suspended_send();
+    test_wait_resume();
+    test_idle();
+
+    XINPUT_CHECK_EQ(mock_usbd_counters()->xfer_violations, 0);
+    return xinput_test_result();
+}
@@ -0,0 +1,149 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Trace ring, built with CFG_XINPUT_TRACE: the events the driver records for
+// a session through the mock device stack, with their instance, argument and
+// virtual time, and dumping a ring that has wrapped.
+
+#include "xinput_test.hpp"
+#include "xinput_trace.hpp"
+
+static_assert(CFG_XINPUT_TRACE == 32, "test_trace expects a 32 entry ring");
+
+static Adafruit_USBD_XInput xinput;
+
+typedef struct {
+    uint32_t time_us;
+    uint8_t event;
+    uint8_t instance;
+    uint16_t arg;
+} expected_t;
+
+static void test_session(void) {
+    const uint8_t ep_in = mock_usbd_endpoint(0, TUSB_DIR_IN);
+    const uint8_t ep_out = mock_usbd_endpoint(0, TUSB_DIR_OUT);
+    const uint8_t led[] = { 0x01, 0x03, 0x0A };
+    xinput_report_t report = {};
+    report.report_size = sizeof(xinput_report_t);
+    xinput_report_t read;
+
+    const uint32_t start = xinput_trace_count();
+
+    mock_time_set_us(1000);
+    XINPUT_CHECK(xinput.sendReport(&report));
+    mock_time_set_us(1300);
+    XINPUT_CHECK(xinput_test_read(ep_in, &read));
+
+    xinput.setChangeDetection(true);
+    mock_time_set_us(1400);
+    XINPUT_CHECK(xinput.sendReport(&report));
+    xinput.setChangeDetection(false);
+
+    mock_time_set_us(2000);
+    mock_usbd_sof();
+    mock_time_set_us(2050);
+    mock_usbd_sof();
+    mock_time_set_us(2100);
+    XINPUT_CHECK(mock_usbd_out(ep_out, led, sizeof(led)));
+
+    mock_time_set_us(2200);
+    const tusb_control_request_t capabilities = xinput_test_request(0xC1, 1, 0x0000, 0x0000, 8);
+    XINPUT_CHECK(mock_usbd_control(&capabilities, NULL, NULL));
+    const tusb_control_request_t unknown = xinput_test_request(0xC1, 0x55, 0x0000, 0x0000, 8);
+    XINPUT_CHECK(!mock_usbd_control(&unknown, NULL, NULL));
+
+    report.lx = 1;
+    mock_time_set_us(2300);
+    XINPUT_CHECK(xinput.sendReport(&report));
+    mock_time_set_us(2400);
+    XINPUT_CHECK(mock_usbd_in_fail(ep_in, XFER_RESULT_STALLED));
+
+    mock_time_set_us(2500);
+    mock_usbd_bus_reset();
+
+    const expected_t expected[] = {
+        { 1000, XINPUT_TRACE_SEND, 0, 0 },
+        { 1000, XINPUT_TRACE_IN_ARMED, 0, 0 },
+        { 1300, XINPUT_TRACE_IN_COMPLETE, 0, XFER_RESULT_SUCCESS },
+        { 1400, XINPUT_TRACE_SEND, 0, 1 },
+        { 2000, XINPUT_TRACE_SOF, XINPUT_TRACE_ANY, 0 }, // frame numbers checked below
+        { 2050, XINPUT_TRACE_SOF, XINPUT_TRACE_ANY, 0 },
+        { 2100, XINPUT_TRACE_OUT_RECEIVED, 0, sizeof(led) },
+        { 2200, XINPUT_TRACE_CONTROL, XINPUT_TRACE_ANY, 1 },
+        { 2200, XINPUT_TRACE_CONTROL, XINPUT_TRACE_ANY, 0x155 },
+        { 2300, XINPUT_TRACE_SEND, 0, 0 },
+        { 2300, XINPUT_TRACE_IN_ARMED, 0, 0 },
+        { 2400, XINPUT_TRACE_IN_COMPLETE, 0, XFER_RESULT_STALLED },
+        { 2500, XINPUT_TRACE_RESET, XINPUT_TRACE_ANY, 0 },
+    };
+    const uint32_t count = sizeof(expected) / sizeof(expected[0]);
+    XINPUT_CHECK_EQ(xinput_trace_count() - start, count);
+
+    xinput_trace_entry_t entries[count];
+    XINPUT_CHECK_EQ(xinput_trace_dump(entries, count), count);
+    for (uint32_t i = 0; i < count; i++) {
+        XINPUT_CHECK_EQ(entries[i].time_us, expected[i].time_us);
+        XINPUT_CHECK_EQ(entries[i].event, expected[i].event);
+        XINPUT_CHECK_EQ(entries[i].instance, expected[i].instance);
+        if (expected[i].event != XINPUT_TRACE_SOF) {
+            XINPUT_CHECK_EQ(entries[i].arg, expected[i].arg);
+        }
+    }
+    XINPUT_CHECK_EQ(entries[5].arg, (uint16_t)(entries[4].arg + 1));
+    XINPUT_CHECK(mock_usbd_configure());
+}
+
+static void test_wrap(void) {
+    const uint32_t start = xinput_trace_count();
+    for (uint16_t i = 0; i < CFG_XINPUT_TRACE + 8; i++) {
+        mock_time_set_us(10000 + i);
+        XINPUT_TRACE(XINPUT_TRACE_USER, 1, i);
+    }
+    XINPUT_CHECK_EQ(xinput_trace_count() - start, CFG_XINPUT_TRACE + 8);
+
+    // Only the newest ring's worth survives, oldest first
+    xinput_trace_entry_t entries[CFG_XINPUT_TRACE + 8];
+    XINPUT_CHECK_EQ(xinput_trace_dump(entries, CFG_XINPUT_TRACE + 8), CFG_XINPUT_TRACE);
+    for (uint16_t i = 0; i < CFG_XINPUT_TRACE; i++) {
+        XINPUT_CHECK_EQ(entries[i].event, XINPUT_TRACE_USER);
+        XINPUT_CHECK_EQ(entries[i].instance, 1);
+        XINPUT_CHECK_EQ(entries[i].arg, i + 8);
+        XINPUT_CHECK_EQ(entries[i].time_us, 10000 + i + 8);
+    }
+
+    // A shorter dump gets the newest entries
+    XINPUT_CHECK_EQ(xinput_trace_dump(entries, 4), 4);
+    XINPUT_CHECK_EQ(entries[0].arg, CFG_XINPUT_TRACE + 4);
+    XINPUT_CHECK_EQ(entries[3].arg, CFG_XINPUT_TRACE + 7);
+}
+
+int main(void) {
+    XINPUT_CHECK(xinput.begin());
+    XINPUT_CHECK(xinput_test_attach());
+
+    test_session();
+    test_wrap();
+
+    return xinput_test_result();
+}
@@ -0,0 +1,144 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef XINPUT_TEST_HPP_
+#define XINPUT_TEST_HPP_
+
+#include "Adafruit_USBD_XInput.hpp"
+#include "mock_usbd.h"
+
+#include <Arduino.h>
+
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Minimal test and benchmark helpers for the host build. Checks report and
+// count failures, xinput_test_result() turns the count into the exit code.
+
+static int xinput_test_failures = 0;
+
+static inline void xinput_check(bool ok, const char *expr, const char *file, int line) {
+    if (!ok) {
+        fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+        xinput_test_failures++;
+    }
+}
+
+static inline void xinput_check_eq(
+    long long a,
+    long long b,
+    const char *expr,
+    const char *file,
+    int line
+) {
+    if (a != b) {
+        fprintf(stderr, "%s:%d: check failed: %s (%lld != %lld)\n", file, line, expr, a, b);
+        xinput_test_failures++;
+    }
+}
+
+#define XINPUT_CHECK(_cond) xinput_check((_cond), #_cond, __FILE__, __LINE__)
+#define XINPUT_CHECK_EQ(_a, _b)                                                           \
+    xinput_check_eq((long long)(_a), (long long)(_b), #_a " == " #_b, __FILE__, __LINE__)
+
+static inline int xinput_test_result(void) {
+    if (xinput_test_failures) {
+        fprintf(stderr, "%d check(s) failed\n", xinput_test_failures);
+        return 1;
+    }
+    return 0;
+}
+
+// Brings the mock bus up like a host would on attach: reset, then
+// SET_CONFIGURATION, which opens every interface begun so far
+static inline bool xinput_test_attach(void) {
+    mock_usbd_init();
+    mock_usbd_bus_reset();
+    return mock_usbd_configure();
+}
+
+// Host read of an IN report, false if the endpoint NAKed
+static inline bool xinput_test_read(uint8_t ep_in, xinput_report_t *report) {
+    return mock_usbd_in(ep_in, (uint8_t *)report, sizeof(xinput_report_t)) ==
+           (int)sizeof(xinput_report_t);
+}
+
+static inline tusb_control_request_t xinput_test_request(
+    uint8_t bmRequestType,
+    uint8_t bRequest,
+    uint16_t wValue,
+    uint16_t wIndex,
+    uint16_t wLength
+) {
+    tusb_control_request_t request;
+    request.bmRequestType = bmRequestType;
+    request.bRequest = bRequest;
+    request.wValue = wValue;
+    request.wIndex = wIndex;
+    request.wLength = wLength;
+    return request;
+}
+
+static inline uint64_t xinput_bench_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Runs fn iterations times and prints the average cost per call. Cycles are
+// TSC reference cycles and only reported on x86.
+template <typename Fn> static double xinput_bench(const char *name, uint32_t iterations, Fn fn) {
+    const auto start = std::chrono::steady_clock::now();
+    const uint64_t start_cycles = xinput_bench_cycles();
+    for (uint32_t i = 0; i < iterations; i++) {
+        fn(i);
+    }
+    const uint64_t cycles = xinput_bench_cycles() - start_cycles;
+    const std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    const double ns = elapsed.count() / iterations;
+    printf(
+        "%-40s %10.1f ns/op %10.1f cycles/op (%u iterations)\n",
+        name,
+        ns,
+        (double)cycles / iterations,
+        iterations
+    );
+    return ns;
+}
+
+// Keeps the compiler from optimizing a benchmarked result away
+template <typename T> static inline void xinput_bench_keep(const T &value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+#endif /* XINPUT_TEST_HPP_ */